@@ -43,6 +43,10 @@ typedef unsigned spinlock_data_t;
 void spinlock_data_set(volatile spinlock_data_t *sd, unsigned val);
 spinlock_data_t spinlock_data_get(volatile spinlock_data_t *sd);
 spinlock_data_t spinlock_data_testandset(volatile spinlock_data_t *sd);
+spinlock_data_t spinlock_data_swap(volatile spinlock_data_t *sd,
+				   spinlock_data_t val);
+spinlock_data_t spinlock_data_cas(volatile spinlock_data_t *sd,
+				  spinlock_data_t old, spinlock_data_t val);
 
 ////////////////////////////////////////////////////////////
 
@@ -93,5 +97,68 @@ spinlock_data_testandset(volatile spinlock_data_t *sd)
 	return x;
 }
 
+SPINLOCK_INLINE
+spinlock_data_t
+spinlock_data_swap(volatile spinlock_data_t *sd, spinlock_data_t val)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	/*
+	 * Atomic exchange: store VAL and return the old value.
+	 * Unlike testandset, retry until the SC succeeds.
+	 */
+
+	do {
+		y = val;
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *sd */
+			"sc %1, 0(%2);"		/*   *sd = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=r" (x), "+r" (y) : "r" (sd));
+	} while (y == 0);
+	return x;
+}
+
+SPINLOCK_INLINE
+spinlock_data_t
+spinlock_data_cas(volatile spinlock_data_t *sd, spinlock_data_t old,
+		  spinlock_data_t val)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	/*
+	 * Compare-and-swap: if *SD is OLD, store VAL. Returns the value
+	 * found in *SD; the swap happened if that is OLD.
+	 *
+	 * Y is preset to 0 so that it reads as "failed" if we branch
+	 * around the SC; in that case X != OLD and we don't retry. If
+	 * X == OLD but the SC failed, retry.
+	 */
+
+	do {
+		y = 0;
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			".set noreorder;"	/* we fill the delay slot */
+			"ll %0, 0(%2);"		/*   x = *sd */
+			"bne %0, %3, 1f;"	/*   if (x != old) goto 1 */
+			"nop;"			/*   (delay slot) */
+			"move %1, %4;"		/*   y = val */
+			"sc %1, 0(%2);"		/*   *sd = y; y = success? */
+			"1:"
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "+&r" (y)
+			: "r" (sd), "r" (old), "r" (val));
+	} while (x == old && y == 0);
+	return x;
+}
+
 
 #endif /* _MIPS_SPINLOCK_H_ */
@@ -35,7 +35,20 @@
 #include <thread.h>
 #include <current.h>
 #include <syscall.h>
+#include <kstat.h>
+#include <endian.h>
+#include <copyinout.h>
+#include <kern/multicall.h>
 
+/* Statistics */
+static struct kstat ks_syscalls = KSTAT_COUNTER("syscall.calls");
+static struct kstat ks_syserrors = KSTAT_COUNTER("syscall.errors");
+#if OPT_A2
+static struct kstat ks_batched = KSTAT_COUNTER("syscall.batched");
+
+static int sys_multicall(userptr_t ucalls, unsigned ncalls, int flags,
+                         int *retval);
+#endif
 
 /*
  * System call dispatcher.
@@ -74,17 +87,23 @@
  * values) further arguments must be fetched from the user-level
  * stack, starting at sp+16 to skip over the slots for the
  * registerized values, with copyin().
+ *
+ * syscall_dispatch does the call itself, for syscall and for each call
+ * in a multicall. It reads only v0, a0-a3 and sp from TF and hands the
+ * result back in *RETP; *RET64P says whether it is a 64-bit value.
  */
-void
-syscall(struct trapframe *tf)
+static int
+syscall_dispatch(struct trapframe *tf, off_t *retp, bool *ret64p)
 {
    int callno;
    int32_t retval;
    int err;
-
-   KASSERT(curthread != NULL);
-   KASSERT(curthread->t_curspl == 0);
-   KASSERT(curthread->t_iplhigh_count == 0);
+#if OPT_A2
+   off_t retval64;
+   bool ret64 = false;
+   uint64_t pos;
+   int whence;
+#endif
 
    callno = tf->tf_v0;
 
@@ -136,11 +155,139 @@ syscall(struct trapframe *tf)
    case SYS_fork:
       err = sys_fork(tf, (pid_t *)&retval);
       break;
+   case SYS_vfork:
+      err = sys_vfork(tf, (pid_t *)&retval);
+      break;
    case SYS_execv:
       err = sys_execv((userptr_t)tf->tf_a0, 
                       (userptr_t)tf->tf_a1, 
                       (int*)&retval);
       break;
+   case SYS_spawn:
+      err = sys_spawn((userptr_t)tf->tf_a0,
+                      (userptr_t)tf->tf_a1,
+                      (pid_t *)&retval);
+      break;
+   case SYS_open:
+      err = sys_open((userptr_t)tf->tf_a0,
+                     (int)tf->tf_a1,
+                     (mode_t)tf->tf_a2,
+                     (int *)&retval);
+      break;
+   case SYS_read:
+      err = sys_read((int)tf->tf_a0,
+                     (userptr_t)tf->tf_a1,
+                     (int)tf->tf_a2,
+                     (int *)&retval);
+      break;
+   case SYS_readv:
+      err = sys_readv((int)tf->tf_a0,
+                      (userptr_t)tf->tf_a1,
+                      (int)tf->tf_a2,
+                      (int *)&retval);
+      break;
+   case SYS_writev:
+      err = sys_writev((int)tf->tf_a0,
+                       (userptr_t)tf->tf_a1,
+                       (int)tf->tf_a2,
+                       (int *)&retval);
+      break;
+   case SYS_pread:
+   case SYS_pwrite:
+   case SYS_preadv:
+   case SYS_pwritev:
+      /* a3 is padding; the aligned 64-bit pos is on the user stack */
+      err = copyin((userptr_t)(tf->tf_sp + 16), &pos, sizeof(pos));
+      if (err) {
+         break;
+      }
+      switch (callno) {
+      case SYS_pread:
+         err = sys_pread((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+                         (size_t)tf->tf_a2, pos, (int *)&retval);
+         break;
+      case SYS_pwrite:
+         err = sys_pwrite((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+                          (size_t)tf->tf_a2, pos, (int *)&retval);
+         break;
+      case SYS_preadv:
+         err = sys_preadv((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+                          (int)tf->tf_a2, pos, (int *)&retval);
+         break;
+      default:
+         err = sys_pwritev((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+                           (int)tf->tf_a2, pos, (int *)&retval);
+         break;
+      }
+      break;
+   case SYS_lseek:
+      /* 64-bit pos is in a2/a3; whence is on the user stack */
+      join32to64(tf->tf_a2, tf->tf_a3, &pos);
+      err = copyin((userptr_t)(tf->tf_sp + 16), &whence, sizeof(int));
+      if (err) {
+         break;
+      }
+      err = sys_lseek((int)tf->tf_a0, pos, whence, &retval64);
+      ret64 = true;
+      break;
+   case SYS_close:
+      err = sys_close((int)tf->tf_a0);
+      break;
+   case SYS_dup2:
+      err = sys_dup2((int)tf->tf_a0,
+                     (int)tf->tf_a1,
+                     (int *)&retval);
+      break;
+   case SYS_fstat:
+      err = sys_fstat((int)tf->tf_a0, (userptr_t)tf->tf_a1);
+      break;
+   case SYS_stat:
+      err = sys_stat((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
+      break;
+   case SYS_remove:
+      err = sys_remove((userptr_t)tf->tf_a0);
+      break;
+   case SYS_mkdir:
+      err = sys_mkdir((userptr_t)tf->tf_a0, (mode_t)tf->tf_a1);
+      break;
+   case SYS_chdir:
+      err = sys_chdir((userptr_t)tf->tf_a0);
+      break;
+   case SYS_pipe:
+      err = sys_pipe((userptr_t)tf->tf_a0);
+      break;
+   case SYS_fdcopy:
+      err = sys_fdcopy((int)tf->tf_a0,
+                       (int)tf->tf_a1,
+                       (size_t)tf->tf_a2,
+                       (int *)&retval);
+      break;
+   case SYS_poll:
+      err = sys_poll((userptr_t)tf->tf_a0,
+                     (unsigned)tf->tf_a1,
+                     (int)tf->tf_a2,
+                     (int *)&retval);
+      break;
+   case SYS_uring_setup:
+      err = sys_uring_setup((userptr_t)tf->tf_a0);
+      break;
+   case SYS_uring_enter:
+      err = sys_uring_enter((unsigned)tf->tf_a0,
+                            (unsigned)tf->tf_a1,
+                            (int *)&retval);
+      break;
+   case SYS_getdirentry:
+      err = sys_getdirentry((int)tf->tf_a0,
+                            (userptr_t)tf->tf_a1,
+                            (size_t)tf->tf_a2,
+                            (int *)&retval);
+      break;
+   case SYS_multicall:
+      err = sys_multicall((userptr_t)tf->tf_a0,
+                          (unsigned)tf->tf_a1,
+                          (int)tf->tf_a2,
+                          (int *)&retval);
+      break;
 #endif
 
    default:
@@ -149,8 +296,35 @@ syscall(struct trapframe *tf)
       break;
    }
 
+#if OPT_A2
+   if (ret64) {
+      *retp = retval64;
+      *ret64p = true;
+      return err;
+   }
+#endif
+   *retp = retval;
+   *ret64p = false;
+   return err;
+}
+
+void
+syscall(struct trapframe *tf)
+{
+   off_t retval;
+   bool ret64;
+   int err;
 
+   KASSERT(curthread != NULL);
+   KASSERT(curthread->t_curspl == 0);
+   KASSERT(curthread->t_iplhigh_count == 0);
+
+   err = syscall_dispatch(tf, &retval, &ret64);
+
+
+   kstat_inc(&ks_syscalls);
    if (err) {
+      kstat_inc(&ks_syserrors);
       /*
        * Return the error code. This gets converted at
        * userlevel to a return value of -1 and the error
@@ -159,6 +333,11 @@ syscall(struct trapframe *tf)
       tf->tf_v0 = err;
       tf->tf_a3 = 1;      /* signal an error */
    }
+   else if (ret64) {
+      /* 64-bit results go in v0 (high) and v1 (low) */
+      split64to32(retval, &tf->tf_v0, &tf->tf_v1);
+      tf->tf_a3 = 0;      /* signal no error */
+   }
    else {
       /* Success. */
       tf->tf_v0 = retval;
@@ -178,6 +357,85 @@ syscall(struct trapframe *tf)
    KASSERT(curthread->t_iplhigh_count == 0);
 }
 
+#if OPT_A2
+/*
+ * multicall: see <kern/multicall.h>. Each call goes through
+ * syscall_dispatch with a trapframe of its own built from its record.
+ * sp points at mc_args in the user's copy of the record, so arguments
+ * past a3 are fetched from sp+16 exactly as for a real trap.
+ */
+static int
+sys_multicall(userptr_t ucalls, unsigned ncalls, int flags, int *retval)
+{
+   struct multicall *calls;
+   struct multicall *mc;
+   struct trapframe mtf;
+   off_t ret;
+   bool ret64;
+   unsigned i;
+   int err;
+
+   if (ncalls > MULTICALL_MAX || (flags & ~MC_STOPONERR) != 0) {
+      return EINVAL;
+   }
+   if (ncalls == 0) {
+      *retval = 0;
+      return 0;
+   }
+   calls = kmalloc(ncalls * sizeof(*calls));
+   if (calls == NULL) {
+      return ENOMEM;
+   }
+   err = copyin(ucalls, calls, ncalls * sizeof(*calls));
+   if (err) {
+      kfree(calls);
+      return err;
+   }
+
+   for (i = 0; i < ncalls; i++) {
+      mc = &calls[i];
+      switch (mc->mc_callno) {
+      case SYS_fork:
+      case SYS_vfork:
+      case SYS_execv:
+      case SYS__exit:
+      case SYS_multicall:
+         /* these need the real trapframe, or never come back */
+         mc->mc_err = EINVAL;
+         break;
+      default:
+         bzero(&mtf, sizeof(mtf));
+         mtf.tf_v0 = mc->mc_callno;
+         mtf.tf_a0 = mc->mc_args[0];
+         mtf.tf_a1 = mc->mc_args[1];
+         mtf.tf_a2 = mc->mc_args[2];
+         mtf.tf_a3 = mc->mc_args[3];
+         mtf.tf_sp = (vaddr_t)((struct multicall *)ucalls)[i].mc_args;
+         mc->mc_err = syscall_dispatch(&mtf, &ret, &ret64);
+         kstat_inc(&ks_batched);
+         break;
+      }
+      mc->mc_retval = mc->mc_err ? 0 : ret;
+      if (mc->mc_err) {
+         kstat_inc(&ks_syserrors);
+         if (flags & MC_STOPONERR) {
+            i++;
+            break;
+         }
+      }
+   }
+
+   /* only the calls that ran */
+   err = copyout(calls, ucalls, i * sizeof(*calls));
+   kfree(calls);
+   if (err) {
+      return err;
+   }
+   *retval = i;
+   return 0;
+}
+#endif
+
 /*
  * Enter user mode for a newly forked process.
  *
@@ -37,8 +37,14 @@
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
+#include "opt-A2.h"
 #include "opt-A3.h"
+#if OPT_A2
+#include <uring.h>
+#endif
 #include <array.h>
+#include <kern/kdata.h>
+#include <kdata.h>
 
 
 /*
@@ -46,8 +52,10 @@
  * enough to struggle off the ground.
  */
 
-/* under dumbvm, always have 48k of user stack */
-#define DUMBVM_STACKPAGES    12
+#if OPT_A2
+/* the uring page, one unmapped page below the stack */
+#define DUMBVM_RINGBASE      (USERSTACK - (DUMBVM_STACKPAGES + 2) * PAGE_SIZE)
+#endif
 
 /*
  * Wrap rma_stealmem in a spinlock.
@@ -219,6 +227,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	uint32_t ehi, elo;
 	struct addrspace *as;
 	int spl;
+	bool readonly = false;
 
 	faultaddress &= PAGE_FRAME;
 
@@ -262,6 +271,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	KASSERT(as->as_page_table2 != 0);
 	KASSERT(as->as_npages2 != 0);
 	KASSERT(as->as_stack_page_table != 0);
+	KASSERT(as->as_kdata_page != 0);
 	KASSERT((as->as_vbase1 & PAGE_FRAME) == as->as_vbase1);
 	KASSERT((as->as_page_table1 & PAGE_FRAME) == as->as_page_table1);
 	KASSERT((as->as_vbase2 & PAGE_FRAME) == as->as_vbase2);
@@ -284,6 +294,19 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	else if (faultaddress >= stackbase && faultaddress < stacktop) {
 		paddr = (faultaddress - stackbase) + as->as_stack_page_table;
 	}
+#if OPT_A2
+	else if (faultaddress == DUMBVM_RINGBASE && as->as_ring_page != 0) {
+		paddr = as->as_ring_page;
+	}
+#endif
+	else if (faultaddress == KDATA_SYSPAGE) {
+		paddr = kdata_syspage();
+		readonly = true;
+	}
+	else if (faultaddress == KDATA_PROCPAGE) {
+		paddr = as->as_kdata_page;
+		readonly = true;
+	}
 	else {
 		return EFAULT;
 	}
@@ -299,6 +322,8 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	// if it's the code segment, set read only by removing the dirty bit
 	if (faultaddress >= vbase1 && faultaddress < vtop1 && as->load_done) {
 		elo = paddr | TLBLO_VALID;
+	} else if (readonly) {
+		elo = paddr | TLBLO_VALID;
 	} else {
 		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
 	}
@@ -313,7 +338,10 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 			continue;
 		}
 		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+		elo = paddr | TLBLO_VALID;
+		if (!readonly) {
+			elo |= TLBLO_DIRTY;
+		}
 		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
@@ -341,7 +369,12 @@ as_create(void)
 	as->as_page_table2 = 0;
 	as->as_npages2 = 0;
 	as->as_stack_page_table = 0;
+	as->as_kdata_page = 0;
 	as->load_done = false;
+#if OPT_A2
+	as->as_ring_page = 0;
+	as->as_uring = NULL;
+#endif
 	
 	return as;
 }
@@ -349,6 +382,15 @@ as_create(void)
 void
 as_destroy(struct addrspace *as)
 {
+#if OPT_A2
+	/* outstanding I/O may still be using our pages */
+	if (as->as_uring != NULL) {
+		uring_destroy(as->as_uring);
+	}
+	if (as->as_ring_page != 0) {
+		free_kpages(PADDR_TO_KVADDR(as->as_ring_page));
+	}
+#endif
 	// if (as->as_page_table1) {
 		// kprintf("as_destroy: kfree_kpages %p\n", (void*)PADDR_TO_KVADDR(as->as_page_table1));
 		free_kpages(PADDR_TO_KVADDR(as->as_page_table1));
@@ -361,10 +403,30 @@ as_destroy(struct addrspace *as)
 		// kprintf("as_destroy: kfree_kpages %p\n", (void*)PADDR_TO_KVADDR(as->as_stack_page_table));
 		free_kpages(PADDR_TO_KVADDR(as->as_stack_page_table));
 	// }
+	free_kpages(PADDR_TO_KVADDR(as->as_kdata_page));
 	
 	kfree(as);
 }
 
+/*
+ * Show the current process's pid in AS's kernel data page. Done on
+ * every activation, so a vfork child that borrows its parent's space
+ * sees its own pid, and the parent sees its own again after.
+ */
+static
+void
+as_setpid(struct addrspace *as)
+{
+	struct kdata_proc *kp;
+
+	kp = (struct kdata_proc *)PADDR_TO_KVADDR(as->as_kdata_page);
+#if OPT_A2
+	kp->kp_pid = curproc->pid;
+#else
+	kp->kp_pid = 1;		/* as sys_getpid */
+#endif
+}
+
 void
 as_activate(void)
 {
@@ -379,6 +441,11 @@ as_activate(void)
 		return;
 	}
 
+	/* exec activates the new space before loading into it */
+	if (as->as_kdata_page != 0) {
+		as_setpid(as);
+	}
+
 	/* Disable interrupts on this CPU while frobbing the TLB. */
 	spl = splhigh();
 
@@ -447,6 +514,7 @@ as_prepare_load(struct addrspace *as)
 	KASSERT(as->as_page_table1 == 0);
 	KASSERT(as->as_page_table2 == 0);
 	KASSERT(as->as_stack_page_table == 0);
+	KASSERT(as->as_kdata_page == 0);
 
 	as->as_page_table1 = getppages(as->as_npages1);
 	if (as->as_page_table1 == 0) {
@@ -462,10 +530,16 @@ as_prepare_load(struct addrspace *as)
 	if (as->as_stack_page_table == 0) {
 		return ENOMEM;
 	}
+
+	as->as_kdata_page = getppages(1);
+	if (as->as_kdata_page == 0) {
+		return ENOMEM;
+	}
 	
 	as_zero_region(as->as_page_table1, as->as_npages1);
 	as_zero_region(as->as_page_table2, as->as_npages2);
 	as_zero_region(as->as_stack_page_table, DUMBVM_STACKPAGES);
+	as_zero_region(as->as_kdata_page, 1);
 
 	return 0;
 }
@@ -473,6 +547,8 @@ as_prepare_load(struct addrspace *as)
 int
 as_complete_load(struct addrspace *as)
 {
+	/* the process loading it is the one that will run in it */
+	as_setpid(as);
 #if OPT_A3
 	as->load_done = true;
 #endif
@@ -488,6 +564,75 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+#if OPT_A2
+int
+as_define_ring(struct addrspace *as, vaddr_t *uaddr, void **kaddr)
+{
+	if (as->as_ring_page == 0) {
+		as->as_ring_page = getppages(1);
+		if (as->as_ring_page == 0) {
+			return ENOMEM;
+		}
+	}
+	as_zero_region(as->as_ring_page, 1);
+
+	*uaddr = DUMBVM_RINGBASE;
+	*kaddr = (void *)PADDR_TO_KVADDR(as->as_ring_page);
+	return 0;
+}
+
+int
+as_kaddr(struct addrspace *as, userptr_t uaddr, size_t len, bool write,
+	 void **kaddr)
+{
+	vaddr_t vaddr = (vaddr_t)uaddr;
+	vaddr_t base;
+	paddr_t paddr;
+	size_t npages;
+
+	if (vaddr + len < vaddr) {
+		return EFAULT;
+	}
+
+	if (vaddr >= as->as_vbase1 &&
+	    vaddr < as->as_vbase1 + as->as_npages1 * PAGE_SIZE) {
+#if OPT_A3
+		/* text is read-only once loaded, as in vm_fault */
+		if (write && as->load_done) {
+			return EFAULT;
+		}
+#else
+		(void)write;
+#endif
+		base = as->as_vbase1;
+		paddr = as->as_page_table1;
+		npages = as->as_npages1;
+	}
+	else if (vaddr >= as->as_vbase2 &&
+		 vaddr < as->as_vbase2 + as->as_npages2 * PAGE_SIZE) {
+		base = as->as_vbase2;
+		paddr = as->as_page_table2;
+		npages = as->as_npages2;
+	}
+	else if (vaddr >= USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE &&
+		 vaddr < USERSTACK) {
+		base = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+		paddr = as->as_stack_page_table;
+		npages = DUMBVM_STACKPAGES;
+	}
+	else {
+		return EFAULT;
+	}
+
+	/* each region is physically contiguous, so this is all we need */
+	if (vaddr + len > base + npages * PAGE_SIZE) {
+		return EFAULT;
+	}
+	*kaddr = (void *)PADDR_TO_KVADDR(paddr + (vaddr - base));
+	return 0;
+}
+#endif
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
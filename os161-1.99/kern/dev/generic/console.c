@@ -52,6 +52,7 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <uio.h>
 #include <thread.h>
@@ -194,6 +195,7 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars_head = nexthead;
 		
 	V(cs->cs_rsem);
+	pollq_wake(&cs->cs_pollq);
 }
 
 /*
@@ -360,6 +362,35 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Input is ready once there is a character in the buffer. Output
+ * never blocks for long, so always counts as ready.
+ */
+static
+int
+con_poll(struct device *dev, int events, int *revents, struct pollwaiter *pw)
+{
+	struct con_softc *cs = dev->d_data;
+	int result;
+
+	*revents = events & POLLOUT;
+	if ((events & POLLIN) == 0) {
+		return 0;
+	}
+	if (cs->cs_gotchars_head == cs->cs_gotchars_tail && *revents == 0 &&
+	    pw != NULL) {
+		/* register, then look again in case input just came in */
+		result = pollq_add(&cs->cs_pollq, pw);
+		if (result) {
+			return result;
+		}
+	}
+	if (cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+		*revents |= POLLIN;
+	}
+	return 0;
+}
+
 static
 int
 attach_console_to_vfs(struct con_softc *cs)
@@ -376,6 +407,7 @@ attach_console_to_vfs(struct con_softc *cs)
 	dev->d_close = con_close;
 	dev->d_io = con_io;
 	dev->d_ioctl = con_ioctl;
+	dev->d_poll = con_poll;
 	dev->d_blocks = 0;
 	dev->d_blocksize = 1;
 	dev->d_data = cs;
@@ -441,6 +473,7 @@ config_con(struct con_softc *cs, int unit)
 	cs->cs_wsem = wsem; 
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	pollq_init(&cs->cs_pollq);
 
 	the_console = cs;
 	con_userlock_read = rlk;
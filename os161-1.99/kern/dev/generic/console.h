@@ -30,6 +30,8 @@
 #ifndef _GENERIC_CONSOLE_H_
 #define _GENERIC_CONSOLE_H_
 
+#include <pollq.h>
+
 /*
  * Device data for the hardware-independent system console.
  *
@@ -53,6 +55,7 @@ struct con_softc {
 	unsigned char cs_gotchars[CONSOLE_INPUT_BUFFER_SIZE];
 	unsigned cs_gotchars_head;	/* next slot to put a char in */
 	unsigned cs_gotchars_tail;	/* next slot to take a char out */
+	struct pollq cs_pollq;		/* pollers waiting for input */
 };
 
 /*
@@ -1085,6 +1085,7 @@ static const struct vnode_ops emufs_fileops = {
 	emufs_uio_op_notdir, /* getdirentry */
 	emufs_write,
 	emufs_ioctl,
+	vnode_pollready,
 	emufs_stat,
 	emufs_file_gettype,
 	emufs_tryseek,
@@ -1120,6 +1121,7 @@ static const struct vnode_ops emufs_dirops = {
 	emufs_getdirentry,
 	emufs_uio_op_isdir,   /* write */
 	emufs_ioctl,
+	vnode_pollready,
 	emufs_stat,
 	emufs_dir_gettype,
 	emufs_dir_tryseek,
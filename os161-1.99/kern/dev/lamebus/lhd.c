@@ -36,6 +36,8 @@
 #include <lib.h>
 #include <uio.h>
 #include <synch.h>
+#include <clock.h>
+#include <kstat.h>
 #include <platform/bus.h>
 #include <vfs.h>
 #include <lamebus/lhd.h>
@@ -59,6 +61,13 @@
 /* Buffer (offset within slot)  */
 #define LHD_BUFFER      32768
 
+/* Statistics, for all disks together */
+static struct kstat ks_reads = KSTAT_COUNTER("disk.read_sectors");
+static struct kstat ks_writes = KSTAT_COUNTER("disk.write_sectors");
+static struct percpu_counter ks_iotime_buckets[KSTAT_NBUCKETS];
+static struct kstat ks_iotime =
+	KSTAT_HISTOGRAM("disk.io_usec", ks_iotime_buckets);
+
 /*
  * Shortcut for reading a register.
  */
@@ -208,6 +217,8 @@ lhd_io(struct device *d, struct uio *uio)
 	uint32_t lenoff = uio->uio_resid % LHD_SECTSIZE;
 	uint32_t i;
 	uint32_t statval = LHD_WORKING;
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
 	int result;
 
 	/* Don't allow I/O that isn't sector-aligned. */
@@ -225,6 +236,8 @@ lhd_io(struct device *d, struct uio *uio)
 		statval |= LHD_ISWRITE;
 	}
 
+	gettime(&secs1, &nsecs1);
+
 	/* Loop over all the sectors we were asked to do. */
 	for (i=0; i<len; i++) {
 
@@ -272,6 +285,11 @@ lhd_io(struct device *d, struct uio *uio)
 		}
 	}
 
+	gettime(&secs2, &nsecs2);
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs2, &nsecs2);
+	kstat_record(&ks_iotime, secs2 * 1000000 + nsecs2 / 1000);
+	kstat_add(uio->uio_rw == UIO_WRITE ? &ks_writes : &ks_reads, len);
+
 	return 0;
 }
 
@@ -306,11 +324,16 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 	lh->lh_dev.d_close = lhd_close;
 	lh->lh_dev.d_io = lhd_io;
 	lh->lh_dev.d_ioctl = lhd_ioctl;
+	lh->lh_dev.d_poll = NULL;
 	lh->lh_dev.d_blocks = bus_read_register(lh->lh_busdata, lh->lh_buspos,
 						LHD_REG_NSECT);
 	lh->lh_dev.d_blocksize = LHD_SECTSIZE;
 	lh->lh_dev.d_data = lh;
 
+	kstat_register(&ks_reads);
+	kstat_register(&ks_writes);
+	kstat_register(&ks_iotime);
+
 	/* Add the VFS device structure to the VFS device list. */
 	return vfs_adddev(name, &lh->lh_dev, 1);
 }
@@ -1587,6 +1587,7 @@ static const struct vnode_ops sfs_fileops = {
 	NOTDIR,  /* getdirentry */
 	sfs_write,
 	sfs_ioctl,
+	vnode_pollready,
 	sfs_stat,
 	sfs_gettype,
 	sfs_tryseek,
@@ -1622,6 +1623,7 @@ static const struct vnode_ops sfs_dirops = {
 	UNIMP,   /* getdirentry */
 	ISDIR,   /* write */
 	sfs_ioctl,
+	vnode_pollready,
 	sfs_stat,
 	sfs_gettype,
 	UNIMP,   /* tryseek */
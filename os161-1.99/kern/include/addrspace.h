@@ -36,9 +36,17 @@
 
 
 #include <vm.h>
+#include "opt-A2.h"
 #include "opt-A3.h"
 
 struct vnode;
+struct uring;
+
+/*
+ * Under dumbvm, always have 48k of user stack. Exec arguments have to
+ * fit on it too, so runprogram.c bounds them by this.
+ */
+#define DUMBVM_STACKPAGES    12
 
 
 /* 
@@ -56,9 +64,14 @@ struct addrspace {
   vaddr_t as_page_table2;
   size_t as_npages2;
   vaddr_t as_stack_page_table;
+  paddr_t as_kdata_page;   /* our struct kdata_proc, read-only to us */
 #if OPT_A3
   bool load_done;
 #endif
+#if OPT_A2
+  paddr_t as_ring_page;    /* shared with the kernel for uring, or 0 */
+  struct uring *as_uring;
+#endif
 };
 
 /*
@@ -95,6 +108,17 @@ struct addrspace {
  *    as_define_stack - set up the stack region in the address space.
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
+ *
+ *    as_define_ring - map a zeroed page for an I/O ring (see
+ *                <kern/uring.h>), or re-zero the one already mapped.
+ *                Hands back its user address and its kernel address.
+ *                The page goes away with the address space and is
+ *                not copied by as_copy.
+ *
+ *    as_kaddr  - return the kernel address of LEN bytes of user memory
+ *                at UADDR, which must be mapped contiguously and, if
+ *                WRITE, writeable. Fails with EFAULT otherwise. Unlike
+ *                copyin/copyout, works from any thread.
  */
 
 struct addrspace *as_create(void);
@@ -111,6 +135,12 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+#if OPT_A2
+int               as_define_ring(struct addrspace *as, vaddr_t *uaddr,
+                                 void **kaddr);
+int               as_kaddr(struct addrspace *as, userptr_t uaddr, size_t len,
+                           bool write, void **kaddr);
+#endif
 
 
 /*
@@ -118,9 +148,16 @@ int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
  *    load_elf - load an ELF user program executable into the current
  *               address space. Returns the entry point (initial PC)
  *               in the space pointed to by ENTRYPOINT.
+ *
+ *    execcache_flush - forget any cached image of V (of every file if
+ *               V is NULL) so its vnode can be released.
+ *
+ *    execcache_bootstrap - one-time setup of the image cache.
  */
 
 int load_elf(struct vnode *v, vaddr_t *entrypoint);
+void execcache_flush(struct vnode *v);
+void execcache_bootstrap(void);
 
 
 #endif /* _ADDRSPACE_H_ */
@@ -59,8 +59,16 @@ struct cpu {
 	 */
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
+	struct threadlist c_threadpool;	/* Dead threads kept for reuse */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 
+	/*
+	 * Queue nodes for queued spinlocks. Allocated only by this
+	 * cpu; other cpus waiting behind us write q_next, and the cpu
+	 * ahead of us clears q_waiting.
+	 */
+	struct spinlock_qnode c_qnodes[SPINLOCK_QNODES];
+
 	/*
 	 * Accessed by other cpus.
 	 * Protected by the runqueue lock.
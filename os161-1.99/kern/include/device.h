@@ -36,16 +36,20 @@
 
 
 struct uio;  /* in <uio.h> */
+struct pollwaiter;  /* in <pollq.h> */
 
 /*
  * Filesystem-namespace-accessible device.
  * d_io is for both reads and writes; the uio indicates the direction.
+ * d_poll is as for VOP_POLL, and may be NULL if the device never blocks.
  */
 struct device {
 	int (*d_open)(struct device *, int flags_from_open);
 	int (*d_close)(struct device *);
 	int (*d_io)(struct device *, struct uio *);
 	int (*d_ioctl)(struct device *, int op, userptr_t data);
+	int (*d_poll)(struct device *, int events, int *revents,
+		      struct pollwaiter *pw);
 
 	blkcnt_t d_blocks;
 	blksize_t d_blocksize;
@@ -61,6 +65,7 @@ struct vnode *dev_create_vnode(struct device *dev);
 
 /* Initialization functions for builtin vfs-level devices. */
 void devnull_create(void);
+void devkstat_create(void);
 
 /* Function that kicks off device probe and attach. */
 void dev_bootstrap(void);
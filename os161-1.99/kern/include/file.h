@@ -0,0 +1,88 @@
+/*
+ * Open files and per-process file descriptor tables.
+ */
+
+#ifndef _FILE_H_
+#define _FILE_H_
+
+#include <spinlock.h>
+#include <limits.h>
+#include <uio.h>
+
+struct vnode;
+struct lock;
+struct iovec;
+
+/*
+ * An open file: what a file descriptor refers to. One openfile may be
+ * shared by several descriptors and processes (after fork), which then
+ * share the seek position too.
+ *
+ * of_offset is protected by of_offsetlock, which is held across each
+ * read or write so they happen at distinct offsets. I/O on objects that
+ * cannot seek (the console, pipes) skips that lock so a blocked read
+ * does not hold up writers; they still count bytes in of_offset, under
+ * of_reflock, because stream devices like kstat: use the offset to
+ * tell when they have reached EOF. of_refcount is protected by
+ * of_reflock too. The rest never changes.
+ */
+struct openfile {
+	struct vnode *of_vnode;
+	int of_accmode;			/* O_RDONLY, O_WRONLY or O_RDWR */
+	bool of_append;			/* O_APPEND */
+	bool of_seekable;
+	struct lock *of_offsetlock;
+	off_t of_offset;
+	struct spinlock of_reflock;
+	unsigned of_refcount;
+};
+
+/*
+ * Wrap VN, which must already be open (as from vfs_open), in a new
+ * openfile. On success the openfile owns VN and closes it at the end.
+ */
+int openfile_create(struct vnode *vn, int openflags, struct openfile **ret);
+/* Open PATH (which may be destroyed) and return a new openfile. */
+int openfile_open(char *path, int openflags, mode_t mode,
+		  struct openfile **ret);
+void openfile_incref(struct openfile *of);
+/* Drop a reference; the last one closes the file. */
+void openfile_decref(struct openfile *of);
+/*
+ * Move TOTAL bytes between the buffers in IOV (user buffers in the
+ * current process, or kernel ones if SEG is UIO_SYSSPACE) and OF. If
+ * POS is NULL the transfer happens at the file's offset, which is
+ * advanced; otherwise it happens at *POS and the offset is left alone.
+ * The byte count comes back in *RETVAL.
+ */
+int openfile_io(struct openfile *of, struct iovec *iov, int iovcnt,
+		size_t total, const off_t *pos, enum uio_rw rw,
+		enum uio_seg seg, int *retval);
+
+/*
+ * A process's descriptor table. Processes are single-threaded, so only
+ * the owning thread (or its parent, while creating it) ever touches
+ * the table and it needs no lock.
+ */
+struct filetable {
+	struct openfile *ft_files[OPEN_MAX];
+};
+
+struct filetable *filetable_create(void);
+void filetable_destroy(struct filetable *ft);
+/* New table sharing every open file of SRC. */
+int filetable_copy(struct filetable *src, struct filetable **ret);
+/* Install OF (taking over the caller's reference) at the lowest free fd. */
+int filetable_place(struct filetable *ft, struct openfile *of, int *fd);
+/* Look up FD; no reference is taken. Fails with EBADF. */
+int filetable_get(struct filetable *ft, int fd, struct openfile **ret);
+/* Empty slot FD and return what was there, with its reference. */
+int filetable_remove(struct filetable *ft, int fd, struct openfile **ret);
+/*
+ * Install OF (taking over the caller's reference) at FD, returning
+ * whatever was there before (or NULL) in *OLD for the caller to drop.
+ */
+void filetable_placeat(struct filetable *ft, struct openfile *of, int fd,
+		       struct openfile **old);
+
+#endif /* _FILE_H_ */
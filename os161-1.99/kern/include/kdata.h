@@ -0,0 +1,17 @@
+/*
+ * Kernel data pages. The layout seen by userland is in <kern/kdata.h>.
+ */
+
+#ifndef _KDATA_H_
+#define _KDATA_H_
+
+/* Allocate the shared page. Call after vm_bootstrap. */
+void kdata_bootstrap(void);
+
+/* Physical address of the shared page, for mapping it. */
+paddr_t kdata_syspage(void);
+
+/* Update the time in the shared page; called by timerclock. */
+void kdata_timerclock(void);
+
+#endif /* _KDATA_H_ */
@@ -0,0 +1,34 @@
+/*
+ * Kernel data pages, mapped read-only into every process so that
+ * getpid() and time() can read the answer instead of trapping.
+ *
+ * KDATA_SYSPAGE is one page shared by every process. It holds the
+ * time of day as of the last timer tick (every 10ms). The kernel bumps
+ * kd_seq to an odd number before changing the time and to an even one
+ * after, so a reader takes kd_seq, reads the time, and starts over if
+ * kd_seq was odd or has since changed.
+ *
+ * KDATA_PROCPAGE is a page of each address space's own, holding the
+ * pid of the process running in it. (A vfork child sees its own pid
+ * while it borrows its parent's space.)
+ *
+ * Both sit below the stack, clear of the uring page.
+ */
+
+#ifndef _KERN_KDATA_H_
+#define _KERN_KDATA_H_
+
+#define KDATA_SYSPAGE	0x7ffe0000
+#define KDATA_PROCPAGE	0x7ffe1000
+
+struct kdata_sys {
+	volatile unsigned kd_seq;
+	volatile time_t kd_sec;
+	volatile unsigned long kd_nsec;
+};
+
+struct kdata_proc {
+	volatile pid_t kp_pid;
+};
+
+#endif /* _KERN_KDATA_H_ */
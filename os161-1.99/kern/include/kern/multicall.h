@@ -0,0 +1,34 @@
+/*
+ * Definitions for multicall(), shared between the kernel and userland.
+ *
+ * multicall(calls, ncalls, flags) runs each call in CALLS in order,
+ * all in one trip into the kernel, and fills in mc_err and mc_retval
+ * for each one it runs. It returns how many it ran; with MC_STOPONERR
+ * that stops after the first call that fails.
+ *
+ * mc_args holds the arguments the way the call would get them on its
+ * own: the first four words are a0-a3 and the rest are the stack
+ * words from sp+16 up. So a 64-bit argument takes an aligned pair of
+ * words, high word first, and may leave a word unused; lseek(fd, pos,
+ * whence), for instance, is { fd, unused, pos high, pos low, whence }.
+ *
+ * fork, vfork, execv, _exit and multicall itself cannot be batched and
+ * fail with EINVAL.
+ */
+
+#ifndef _KERN_MULTICALL_H_
+#define _KERN_MULTICALL_H_
+
+#define MULTICALL_MAX	64	/* most calls in one multicall */
+#define MULTICALL_NARGS	6
+
+#define MC_STOPONERR	1	/* flag: stop at the first error */
+
+struct multicall {
+	int mc_callno;				/* SYS_* */
+	unsigned long mc_args[MULTICALL_NARGS];
+	int mc_err;				/* out: 0 or an errno */
+	off_t mc_retval;			/* out: if mc_err is 0 */
+};
+
+#endif /* _KERN_MULTICALL_H_ */
@@ -0,0 +1,20 @@
+/*
+ * Definitions for poll(), shared between the kernel and userland.
+ */
+
+#ifndef _KERN_POLL_H_
+#define _KERN_POLL_H_
+
+struct pollfd {
+	int fd;			/* descriptor to watch; ignored if negative */
+	short events;		/* what to wait for */
+	short revents;		/* what happened */
+};
+
+#define POLLIN		0x0001	/* reading won't block */
+#define POLLOUT		0x0004	/* writing won't block */
+#define POLLERR		0x0008	/* error; in revents only */
+#define POLLHUP		0x0010	/* other end closed; in revents only */
+#define POLLNVAL	0x0020	/* fd not open; in revents only */
+
+#endif /* _KERN_POLL_H_ */
@@ -0,0 +1,57 @@
+/*
+ * Asynchronous I/O rings, shared between the kernel and userland.
+ *
+ * uring_setup() maps one page into the process holding a struct
+ * uring_ring. The process fills in submission entries and advances
+ * ur_sqtail; uring_enter() hands them to the kernel's I/O threads,
+ * which post a completion entry for each one and advance ur_cqtail.
+ * The process reads completions and advances ur_cqhead. Each index is
+ * written by one side only and counts up forever; the slot is the
+ * index modulo the ring size.
+ *
+ * Requests run in no particular order, possibly all at once. At most
+ * URING_CQ_ENTRIES are outstanding (submitted but not yet reaped), so
+ * the completion ring never overflows.
+ */
+
+#ifndef _KERN_URING_H_
+#define _KERN_URING_H_
+
+#define URING_SQ_ENTRIES	64	/* powers of two */
+#define URING_CQ_ENTRIES	64
+
+#define URING_OP_NOP		0
+#define URING_OP_READ		1
+#define URING_OP_WRITE		2
+
+/* sqe_offset value meaning "at the file offset", like read/write */
+#define URING_OFFSET_CUR	((off_t)-1)
+
+struct uring_sqe {
+	int sqe_op;			/* URING_OP_* */
+	int sqe_fd;
+#ifdef _KERNEL
+	userptr_t sqe_buf;
+#else
+	void *sqe_buf;
+#endif
+	size_t sqe_len;
+	off_t sqe_offset;		/* or URING_OFFSET_CUR */
+	unsigned long sqe_userdata;	/* copied to the completion */
+};
+
+struct uring_cqe {
+	unsigned long cqe_userdata;
+	int cqe_result;			/* byte count, or -errno */
+};
+
+struct uring_ring {
+	volatile unsigned ur_sqhead;	/* kernel: next entry it will take */
+	volatile unsigned ur_sqtail;	/* process: next entry it will fill */
+	volatile unsigned ur_cqhead;	/* process: next completion to read */
+	volatile unsigned ur_cqtail;	/* kernel: next completion to post */
+	struct uring_sqe ur_sq[URING_SQ_ENTRIES];
+	struct uring_cqe ur_cq[URING_CQ_ENTRIES];
+};
+
+#endif /* _KERN_URING_H_ */
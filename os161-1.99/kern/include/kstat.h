@@ -0,0 +1,101 @@
+/*
+ * Kernel statistics registry.
+ *
+ * Any subsystem can declare named statistics, and they can all be
+ * read in one place: the "kstat" menu command, or by reading the
+ * kstat: device, which produces one line per statistic.
+ *
+ * There are three kinds:
+ *
+ *    counter    - counts events. Per-cpu, so bumping one is cheap.
+ *    gauge      - a current level. Either adjusted up and down with
+ *                 kstat_gauge_add (also per-cpu), or computed when read
+ *                 by a function supplied with KSTAT_GAUGEFN.
+ *    histogram  - distribution of some value (sizes, times), in
+ *                 power-of-two buckets. Bucket 0 counts the value 0
+ *                 and bucket i counts values in [2^(i-1), 2^i).
+ *
+ * Declare statistics as static structures with the initializers
+ * below, e.g.
+ *
+ *    static struct kstat ks_foo = KSTAT_COUNTER("foo.events");
+ *
+ * Statistics are registered on first update, or explicitly with
+ * kstat_register if they should be listed even before anything
+ * happens. Statistics are never unregistered, so only use ones with
+ * static storage. Names should be "subsystem.what".
+ */
+
+#ifndef _KSTAT_H_
+#define _KSTAT_H_
+
+#include <percpu.h>
+
+/* Kinds of statistic */
+#define KSTAT_TYPE_COUNTER	0
+#define KSTAT_TYPE_GAUGE	1
+#define KSTAT_TYPE_HISTOGRAM	2
+
+/* Number of histogram buckets (enough for any 32-bit value) */
+#define KSTAT_NBUCKETS	33
+
+struct kstat {
+	const char *ks_name;
+	int ks_type;
+	struct percpu_counter ks_value;	/* count, gauge, or histogram sum */
+	int64_t (*ks_readfn)(void);	/* gauge computed on read */
+	struct percpu_counter *ks_buckets; /* histogram buckets */
+	volatile bool ks_registered;
+	struct kstat *ks_next;		/* registry list */
+};
+
+#define KSTAT_COUNTER(name) \
+	{ name, KSTAT_TYPE_COUNTER, PERCPU_COUNTER_INITIALIZER, \
+	  NULL, NULL, false, NULL }
+#define KSTAT_GAUGE(name) \
+	{ name, KSTAT_TYPE_GAUGE, PERCPU_COUNTER_INITIALIZER, \
+	  NULL, NULL, false, NULL }
+#define KSTAT_GAUGEFN(name, fn) \
+	{ name, KSTAT_TYPE_GAUGE, PERCPU_COUNTER_INITIALIZER, \
+	  fn, NULL, false, NULL }
+/* BUCKETS must be a static struct percpu_counter[KSTAT_NBUCKETS] */
+#define KSTAT_HISTOGRAM(name, buckets) \
+	{ name, KSTAT_TYPE_HISTOGRAM, PERCPU_COUNTER_INITIALIZER, \
+	  NULL, buckets, false, NULL }
+
+/* Register the statistics that belong to no particular subsystem. */
+void kstat_bootstrap(void);
+
+/* Add a statistic to the registry. Does nothing if already there. */
+void kstat_register(struct kstat *ks);
+
+/*
+ * Updating.
+ *
+ * kstat_add	Add N to a counter.
+ * kstat_inc	Add 1 to a counter.
+ * kstat_gauge_add
+ *		Add DELTA (which may be negative) to a gauge.
+ * kstat_record	Record VAL in a histogram.
+ */
+void kstat_add(struct kstat *ks, unsigned n);
+void kstat_gauge_add(struct kstat *ks, int delta);
+void kstat_record(struct kstat *ks, unsigned val);
+
+#define kstat_inc(ks)	kstat_add(ks, 1)
+
+/* Current value of a counter or gauge, or number of samples in a histogram. */
+int64_t kstat_read(struct kstat *ks);
+
+/*
+ * Format every registered statistic into BUF (of size LEN) as text,
+ * one line each. Returns the length the full text needs (not
+ * counting the terminating null), which may be more than LEN, in
+ * which case the text is truncated.
+ */
+size_t kstat_format(char *buf, size_t len);
+
+/* Print all statistics on the console. */
+void kstat_print(void);
+
+#endif /* _KSTAT_H_ */
@@ -0,0 +1,59 @@
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+/*
+ * Lock contention profiling.
+ *
+ * Only built if the kernel is configured with "options lockstat".
+ * When built, spinlock_acquire/release and lock_acquire/release feed
+ * these functions; nothing is recorded until lockstat_enable() is
+ * called (from the kernel menu), since timing uses gettime() and the
+ * clock isn't attached until well into boot.
+ *
+ * Statistics are kept per lock name, so e.g. all the locks called
+ * "vnode" are lumped together. Spinlocks that have not been given a
+ * name with spinlock_setname() are kept per code address of whoever
+ * first acquired them while profiling was on.
+ *
+ * All times are in nanoseconds.
+ */
+
+#include "opt-lockstat.h"
+
+#if OPT_LOCKSTAT
+
+/* Kinds of lock. */
+#define LOCKSTAT_SPIN	0	/* struct spinlock */
+#define LOCKSTAT_SLEEP	1	/* struct lock */
+
+struct lockstat;	/* Opaque; one per lock name. */
+
+/* True while statistics are being collected. */
+extern volatile bool lockstat_enabled;
+
+/*
+ * Find (or make) the record for a lock of kind KIND called NAME. If
+ * NAME is NULL or empty, use SITE (a code address) as the key
+ * instead. Returns NULL if the table is full. Records are never
+ * freed, so the result can be cached in the lock.
+ */
+struct lockstat *lockstat_get(int kind, const char *name, const void *site);
+
+/* Current time, as used for wait and hold times. */
+uint64_t lockstat_now(void);
+
+/*
+ * Record an acquisition that spent WAIT waiting, and whether it had
+ * to wait at all; and record a release after holding for HOLD.
+ */
+void lockstat_acquired(struct lockstat *ls, bool contended, uint64_t wait);
+void lockstat_released(struct lockstat *ls, uint64_t hold);
+
+/* Menu support: turn collection on/off, zero counters, print top N. */
+void lockstat_enable(bool on);
+void lockstat_clear(void);
+void lockstat_print(unsigned max);
+
+#endif /* OPT_LOCKSTAT */
+
+#endif /* _LOCKSTAT_H_ */
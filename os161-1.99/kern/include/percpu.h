@@ -0,0 +1,40 @@
+/*
+ * Per-cpu counters.
+ *
+ * A counter that is bumped often from many cpus (statistics, mostly)
+ * but read rarely. Each cpu increments its own slot with no locking
+ * and no atomic operations, just interrupts off for the moment of the
+ * increment, and a read adds the slots up. A read racing with
+ * increments may miss the most recent ones, which is fine for
+ * statistics.
+ */
+
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+#include <platform/maxcpus.h>
+
+struct percpu_counter {
+	volatile unsigned pc_count[MAXCPUS];	/* indexed by c_number */
+};
+
+/* Initializer for static counters; all zero */
+#define PERCPU_COUNTER_INITIALIZER	{ { 0 } }
+
+/*
+ * init		Zero the counter. Same as reset, for symmetry with
+ *		other kernel objects.
+ * add		Add N to the counter.
+ * inc		Add 1.
+ * read		Return the total over all cpus.
+ * reset	Zero the counter. Increments racing with this may or
+ *		may not be lost.
+ */
+void percpu_counter_init(struct percpu_counter *pc);
+void percpu_counter_add(struct percpu_counter *pc, unsigned n);
+uint64_t percpu_counter_read(struct percpu_counter *pc);
+void percpu_counter_reset(struct percpu_counter *pc);
+
+#define percpu_counter_inc(pc)	percpu_counter_add(pc, 1)
+
+#endif /* _PERCPU_H_ */
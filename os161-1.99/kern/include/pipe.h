@@ -0,0 +1,20 @@
+/*
+ * Anonymous pipes.
+ */
+
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+struct vnode;
+
+/*
+ * Create a pipe and return a vnode for each end. Both come back open
+ * (as if from vfs_open), so drop them with vfs_close. Reads from
+ * *READEND return data written to *WRITEEND, and end-of-file once the
+ * write end is closed and the pipe is drained; writes fail with EPIPE
+ * once the read end is closed. Writes of at most PIPE_BUF bytes are
+ * atomic.
+ */
+int pipe_create(struct vnode **readend, struct vnode **writeend);
+
+#endif /* _PIPE_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Poll wait queues: waiting for any one of several objects at once.
+ *
+ * An object that can block (a pipe end, the console) keeps a struct
+ * pollq for each kind of readiness it has, and calls pollq_wake on it
+ * whenever that readiness may have started. A thread in poll() passes
+ * a struct pollwaiter to each object's VOP_POLL; an object that isn't
+ * ready links it onto the right queue with pollq_add, which must
+ * happen atomically with the readiness check, with respect to
+ * pollq_wake. The thread then calls pollwaiter_wait, which sleeps
+ * until some object wakes it (if none has yet) and unlinks it from
+ * every queue it was added to, or pollwaiter_clear, which just
+ * unlinks it.
+ *
+ * pollq_wake may be called from an interrupt handler.
+ */
+
+#ifndef _POLLQ_H_
+#define _POLLQ_H_
+
+#include <spinlock.h>
+
+struct pollent;
+struct wchan;
+
+struct pollq {
+	struct spinlock pq_lock;
+	struct pollent *pq_head;	/* waiters on this queue */
+};
+
+#define POLLQ_INITIALIZER { SPINLOCK_INITIALIZER, NULL }
+
+struct pollwaiter {
+	struct spinlock pw_lock;
+	struct wchan *pw_wchan;
+	bool pw_woken;			/* protected by pw_lock */
+	struct pollent *pw_ents;	/* queues we are on; owner only */
+};
+
+void pollq_init(struct pollq *pq);
+void pollq_cleanup(struct pollq *pq);	/* must have no waiters */
+int pollq_add(struct pollq *pq, struct pollwaiter *pw);
+void pollq_wake(struct pollq *pq);
+
+int pollwaiter_init(struct pollwaiter *pw);
+void pollwaiter_cleanup(struct pollwaiter *pw);
+/*
+ * Sleep until woken, then leave every queue. If TIMED, also wake up
+ * on every timer tick, so the caller can check a deadline.
+ */
+int pollwaiter_wait(struct pollwaiter *pw, bool timed);
+/* Leave every queue without sleeping. */
+void pollwaiter_clear(struct pollwaiter *pw);
+
+/* Called by timerclock() on every tick. */
+void pollq_timerclock(void);
+
+#endif /* _POLLQ_H_ */
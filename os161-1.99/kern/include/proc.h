@@ -48,19 +48,55 @@ struct semaphore;
 
 
 #if OPT_A2
+/*
+ * Exit status of a process. It is created along with the process and
+ * owns its pid; it lives on after the process exits until its parent
+ * exits too, and only then is the pid free for reuse. A process whose
+ * parent has already exited (parent 0) drops its status when it exits.
+ * Each status lists its children's statuses, so exit only touches the
+ * exiting process's own children.
+ *
+ * Everything here is protected by lk_process_table, except ps_wchan:
+ * threads in waitpid sleep on their own process's ps_wchan, and an
+ * exiting child wakes its parent's ps_wchan under the parent's ps_lock.
+ */
 struct process_status {
   pid_t pid;
   pid_t parent;
-  bool valid;
+  volatile bool valid;
   int exitcode;
-  struct cv* cv_waitpid;
+  struct spinlock ps_lock;
+  struct wchan* ps_wchan;
+  struct process_status* ps_hashnext;   /* pid hash chain */
+  struct process_status* ps_children;   /* our children's statuses */
+  struct process_status* ps_sibling;    /* next in parent's ps_children */
 };
 
-struct array* process_table;
-struct lock* lk_process_table;
-void save_process_status(pid_t new, pid_t parent);
+/*
+ * The process table is a hash from pid to process_status, with pids
+ * handed out round-robin from a bitmap. waitpid looks up and waits for
+ * its children holding lk_process_table for reading, and takes it for
+ * writing only to reap one; creation and exit always write.
+ */
+extern struct rwlock* lk_process_table;
+/* allocate a pid and a status for a new child of parent (may be NULL) */
+int save_process_status(struct process_status* parent,
+                        struct process_status** newps);
 struct process_status* get_process_status(pid_t pid);
 void process_status_destroy(struct process_status* ps);
+/* record self's exit with waitcode, and reap or orphan its children */
+void process_table_exit(struct process_status* self, int waitcode);
+/* mark ps as exited with exitcode and wake its parent's waiters */
+void process_status_exit(struct process_status* ps, int exitcode);
+/*
+ * Wait for child pid of self (any child if pid is -1) to exit, then
+ * reap it, returning its pid and exit code. With WNOHANG, returns with
+ * *reaped set to 0 instead of sleeping. Fails with ESRCH if no process
+ * has that pid, which includes a child that has already been reaped,
+ * and with ECHILD if it isn't a child of self.
+ */
+int process_table_wait(struct process_status* self, pid_t pid, int options,
+                       pid_t* reaped, int* exitcode);
 #endif
 
 /*
@@ -76,8 +112,11 @@ struct proc {
 
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
+#if OPT_A2
+	struct filetable *p_filetable;	/* open file descriptors */
+#endif
 
-#ifdef UW
+#if defined(UW) && !OPT_A2
   /* a vnode to refer to the console device */
   /* this is a quick-and-dirty way to get console writes working */
   /* you will probably need to change this when implementing file-related
@@ -89,7 +128,13 @@ struct proc {
 	/* add more material here as needed */
 #if OPT_A2
    volatile pid_t pid;
-   struct process_status* ps;
+   struct process_status* ps;   /* our status, until we exit */
+   /*
+    * A vfork child runs in p_vforkparent's address space until it
+    * execs or exits, and then Vs the parent's p_vforksem.
+    */
+   struct proc* p_vforkparent;
+   struct semaphore* p_vforksem;
 #endif
    
 };
@@ -124,5 +169,14 @@ struct addrspace *curproc_getas(void);
 /* Change the address space of the current process, and return the old one. */
 struct addrspace *curproc_setas(struct addrspace *);
 
+#if OPT_A2
+/*
+ * Called once p has let go of its address space (exec or exit). If it
+ * was borrowed through vfork, wake the parent and return true; the
+ * caller must then not destroy it.
+ */
+bool proc_vfork_release(struct proc *p);
+#endif
+
 
 #endif /* _PROC_H_ */
@@ -36,6 +36,7 @@
  */
 
 #include <cdefs.h>
+#include "opt-lockstat.h"
 
 /* Inlining support - for making sure an out-of-line copy gets built */
 #ifndef SPINLOCK_INLINE
@@ -45,6 +46,22 @@
 /* Get the machine-dependent bits. */
 #include <machine/spinlock.h>
 
+/*
+ * Queue node for queued (MCS) spinlocks. Each CPU has a small array of
+ * these, one per queued spinlock it may hold or be waiting for at once.
+ * A waiting CPU spins on q_waiting in its own node, and the releasing
+ * CPU clears it; so CPUs spin on separate words, and get the lock in
+ * the order they asked for it.
+ */
+struct spinlock_qnode {
+	struct spinlock_qnode *volatile q_next;	/* Next CPU in line */
+	volatile bool q_waiting;		/* Cleared when it's our turn */
+	bool q_inuse;				/* Node is allocated */
+};
+
+/* Number of queued spinlocks one CPU can hold (or wait for) at once. */
+#define SPINLOCK_QNODES	8
+
 /*
  * Basic spinlock.
  *
@@ -53,30 +70,59 @@
  * This structure is made public so spinlocks do not have to be
  * malloc'd; however, code that uses spinlocks should not look inside
  * the structure directly but always use the spinlock API functions.
+ *
+ * A spinlock is either a plain test-and-test-and-set lock, or a
+ * queued (MCS) lock if it was set up with spinlock_init_queued or
+ * SPINLOCK_QUEUED_INITIALIZER. Plain locks are cheaper when there is
+ * little contention; queued locks are fair and keep waiting CPUs
+ * from all hammering the same word, so use them for hot global locks.
+ * For a queued lock, lk_lock holds the tail of the queue (0 if free).
  */
 struct spinlock {
 	volatile spinlock_data_t lk_lock; /* The memory word where we spin. */
 	struct cpu *lk_holder;		/* CPU holding this lock. */
+	bool lk_queued;			/* True for a queued (MCS) lock. */
+	struct spinlock_qnode *lk_qnode; /* Holder's queue node, if queued. */
+#if OPT_LOCKSTAT
+	const char *lk_name;		/* Name for lockstat, or NULL. */
+	struct lockstat *lk_stat;	/* Lockstat record, once looked up. */
+	uint64_t lk_acquired;		/* When acquired, for hold time. */
+#endif
 };
 
 /*
- * Initializer for cases where a spinlock needs to be static or global.
+ * Initializers for cases where a spinlock needs to be static or global.
  */
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#if OPT_LOCKSTAT
+#define SPINLOCK_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, false, NULL, NULL, NULL, 0 }
+#define SPINLOCK_QUEUED_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, true, NULL, NULL, NULL, 0 }
+#else
+#define SPINLOCK_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, false, NULL }
+#define SPINLOCK_QUEUED_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, NULL, true, NULL }
+#endif
 
 /*
  * Spinlock functions.
  *
  * init		Initialize the contents of a spinlock.
+ * init_queued	Same, but make it a queued (MCS) spinlock.
  * cleanup	Opposite of init. Lock must be unlocked.
  *
  * acquire	Get the lock, spinning as necessary. Also disables interrupts.
  * release	Release the lock. May re-enable interrupts.
  *
  * do_i_hold	Check if the current CPU holds the lock.
+ *
+ * setname	Give the lock a name for lock profiling (lockstat). NAME
+ *		is not copied. Does nothing unless lockstat is configured.
  */
 
 void spinlock_init(struct spinlock *lk);
+void spinlock_init_queued(struct spinlock *lk);
 void spinlock_cleanup(struct spinlock *lk);
 
 void spinlock_acquire(struct spinlock *lk);
@@ -84,5 +130,7 @@ void spinlock_release(struct spinlock *lk);
 
 bool spinlock_do_i_hold(struct spinlock *lk);
 
+void spinlock_setname(struct spinlock *lk, const char *name);
+
 
 #endif /* _SPINLOCK_H_ */
@@ -79,6 +79,11 @@ struct lock {
         volatile bool locked;
         struct wchan* wchan;
         struct thread* curthread;
+        struct lock* lk_nextheld;       /* next lock held by curthread */
+#if OPT_LOCKSTAT
+        struct lockstat* lk_stat;
+        uint64_t lk_acquired;
+#endif
         // (don't forget to mark things volatile as needed)
 };
 
@@ -94,12 +99,26 @@ void lock_acquire(struct lock *);
  *    lock_do_i_hold - Return true if the current thread holds the lock; 
  *                   false otherwise.
  *
+ * On release the lock is handed directly to the longest waiter, if
+ * there is one, so waiters acquire it in FIFO order.
+ *
+ * Locks do priority inheritance: while a thread waits for a lock, the
+ * holder runs at the waiter's priority if that is higher, and so on
+ * down the chain if the holder is itself waiting for a lock. The
+ * holder drops back when it releases the lock.
+ *
  * These operations must be atomic. You get to write them.
  */
 void lock_release(struct lock *);
 bool lock_do_i_hold(struct lock *);
 void lock_destroy(struct lock *);
 
+/*
+ * Recompute T's effective priority from its base priority and the
+ * waiters on the locks it holds. For thread_setpriority.
+ */
+void lock_pi_update(struct thread *t);
+
 
 /*
  * Condition variable.
@@ -136,6 +155,11 @@ void cv_destroy(struct cv *);
  * in. Note that under normal circumstances the same lock should be used
  * on all operations with any particular CV.
  *
+ * cv_signal and cv_broadcast do not actually wake the waiters while the
+ * lock is held; they are moved onto the lock's queue instead and each
+ * is woken, owning the lock, when it is released. This relies on the
+ * lock passed in being the one the waiters passed to cv_wait.
+ *
  * These operations must be atomic. You get to write them.
  */
 void cv_wait(struct cv *cv, struct lock *lock);
@@ -143,4 +167,57 @@ void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
 
 
+/*
+ * Reader-writer lock.
+ *
+ * Any number of readers may hold the lock at once, or a single
+ * writer. Writers are preferred: once a writer is waiting, new
+ * readers queue up behind it. When a writer releases the lock, all
+ * the readers that queued up while it was waiting or running are let
+ * in together before the next writer. So neither side can starve.
+ *
+ * As with locks, ownership is handed directly to the threads being
+ * woken, and the lock is not recursive in either mode. In particular
+ * a thread holding the lock shared must not try to take it shared
+ * again, since a writer may have queued up in between.
+ *
+ * The name field is for easier debugging. A copy of the name is made
+ * internally.
+ */
+struct rwlock {
+        char *rw_name;
+        struct spinlock rw_lock;
+        struct wchan *rw_rwchan;        /* readers waiting */
+        struct wchan *rw_wwchan;        /* writers waiting */
+        volatile unsigned rw_readers;   /* readers holding the lock */
+        volatile unsigned rw_rwaiting;  /* readers waiting */
+        volatile unsigned rw_wwaiting;  /* writers waiting */
+        struct thread *volatile rw_writer; /* writer holding the lock */
+};
+
+struct rwlock *rwlock_create(const char *name);
+void rwlock_destroy(struct rwlock *);
+
+/*
+ * Operations:
+ *    rwlock_acquire_read   - Get the lock shared.
+ *    rwlock_release_read   - Drop a shared hold.
+ *    rwlock_acquire_write  - Get the lock exclusive.
+ *    rwlock_release_write  - Drop an exclusive hold. Only the thread
+ *                            holding the lock may do this.
+ *    rwlock_do_i_hold_write - Return true if the current thread holds
+ *                            the lock exclusive.
+ *    rwlock_is_held        - Return true if anyone holds the lock in
+ *                            either mode. Readers are not tracked
+ *                            individually, so this is the best that
+ *                            can be asserted about a shared hold.
+ */
+void rwlock_acquire_read(struct rwlock *);
+void rwlock_release_read(struct rwlock *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+bool rwlock_do_i_hold_write(struct rwlock *);
+bool rwlock_is_held(struct rwlock *);
+
+
 #endif /* _SYNCH_H_ */
@@ -70,12 +70,50 @@ int sys_getpid(pid_t *retval);
 int sys_waitpid(pid_t pid, userptr_t status, int options, pid_t *retval);
 #if OPT_A2
 int sys_fork(struct trapframe*tf, pid_t *retval);
+int sys_vfork(struct trapframe*tf, pid_t *retval);
 int sys_execv(userptr_t progname, userptr_t args, int* retval);
-int assign_ustack_space(unsigned long argc,
-                        char** argv,
-                        userptr_t* p_arg_string_ptrs,
-                        userptr_t* p_arg_strings,
-                        userptr_t* p_stack_top);
+int sys_spawn(userptr_t progname, userptr_t args, pid_t* retval);
+int sys_open(userptr_t path, int flags, mode_t mode, int *retval);
+int sys_read(int fdesc, userptr_t ubuf, unsigned int nbytes, int *retval);
+int sys_pread(int fdesc, userptr_t ubuf, size_t nbytes, off_t pos, int *retval);
+int sys_pwrite(int fdesc, userptr_t ubuf, size_t nbytes, off_t pos,
+               int *retval);
+int sys_readv(int fdesc, userptr_t iov, int iovcnt, int *retval);
+int sys_writev(int fdesc, userptr_t iov, int iovcnt, int *retval);
+int sys_preadv(int fdesc, userptr_t iov, int iovcnt, off_t pos, int *retval);
+int sys_pwritev(int fdesc, userptr_t iov, int iovcnt, off_t pos,
+                int *retval);
+int sys_lseek(int fdesc, off_t pos, int whence, off_t *retval);
+int sys_getdirentry(int fdesc, userptr_t ubuf, size_t buflen, int *retval);
+int sys_close(int fdesc);
+int sys_dup2(int oldfd, int newfd, int *retval);
+int sys_fstat(int fdesc, userptr_t statbuf);
+int sys_stat(userptr_t path, userptr_t statbuf);
+int sys_remove(userptr_t path);
+int sys_mkdir(userptr_t path, mode_t mode);
+int sys_chdir(userptr_t path);
+int sys_pipe(userptr_t fds);
+int sys_fdcopy(int infd, int outfd, size_t len, int *retval);
+int sys_poll(userptr_t fds, unsigned nfds, int timeout, int *retval);
+int sys_uring_setup(userptr_t ringp);
+int sys_uring_enter(unsigned to_submit, unsigned min_complete, int *retval);
+
+/*
+ * Exec argument strings, packed into one bounded buffer (see
+ * runprogram.c). assign_ustack_space lays them out below *stackptr,
+ * moves *stackptr down past them, and returns the user argv.
+ */
+struct argbuf {
+   char* ab_buf;
+   size_t ab_len;               /* bytes of strings in ab_buf */
+   unsigned long ab_argc;
+};
+int argbuf_init(struct argbuf* ab);
+void argbuf_cleanup(struct argbuf* ab);
+int argbuf_add(struct argbuf* ab, const char* arg);
+int argbuf_copyin(struct argbuf* ab, userptr_t uargv);
+int assign_ustack_space(struct argbuf* ab, vaddr_t* stackptr,
+                        userptr_t* uargv);
 #endif // OPT_A2
 #endif // UW
 
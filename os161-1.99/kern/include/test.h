@@ -60,6 +60,9 @@ int threadtest3(int, char **);
 int semtest(int, char **);
 int locktest(int, char **);
 int cvtest(int, char **);
+int rwtest(int, char **);
+int spinlocktest(int, char **);
+int pitest(int, char **);
 
 #ifdef UW
 /* Another thread and synchronization test */
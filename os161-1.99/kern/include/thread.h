@@ -41,6 +41,7 @@
 #include <threadlist.h>
 
 struct cpu;
+struct lock;
 
 /* get machine-dependent defs */
 #include <machine/thread.h>
@@ -56,6 +57,14 @@ struct cpu;
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
 
+/*
+ * Thread priorities. Higher numbers run first; threads of equal
+ * priority are scheduled round-robin.
+ */
+#define THREAD_PRI_MIN		0
+#define THREAD_PRI_DEFAULT	16
+#define THREAD_PRI_MAX		31
+
 /* States a thread can be in. */
 typedef enum {
 	S_RUN,		/* running */
@@ -101,6 +110,20 @@ struct thread {
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
+	/*
+	 * Scheduling priority.
+	 *
+	 * t_priority is what the scheduler uses: t_basepri, raised to
+	 * that of the highest-priority thread waiting for a lock we
+	 * hold (priority inheritance). t_blockedon and t_heldlocks are
+	 * for computing it, and are protected by the priority
+	 * inheritance lock in synch.c.
+	 */
+	int t_basepri;			/* Priority set by thread_setpriority */
+	volatile int t_priority;	/* Effective priority */
+	struct lock *t_blockedon;	/* Lock we're waiting for, if any */
+	struct lock *t_heldlocks;	/* Locks we hold (via lk_nextheld) */
+
 	/*
 	 * Public fields
 	 */
@@ -118,6 +141,14 @@ struct thread {
 DECLARRAY(thread);
 DEFARRAY(thread, THREADINLINE);
 
+/*
+ * Maximum number of dead threads (with their stacks) each cpu keeps
+ * for reuse by thread_fork. Can be changed at run time with the
+ * "tpool" menu command; 0 turns the pool off.
+ */
+#define THREAD_POOLMAX 16
+extern unsigned thread_poolmax;
+
 /* Call once during system startup to allocate data structures. */
 void thread_bootstrap(void);
 
@@ -157,6 +188,12 @@ void thread_exit(void);
  */
 void thread_yield(void);
 
+/*
+ * Set the current thread's base priority, between THREAD_PRI_MIN and
+ * THREAD_PRI_MAX. New threads get their parent's base priority.
+ */
+void thread_setpriority(int pri);
+
 /*
  * Reshuffle the run queue. Called from the timer interrupt.
  */
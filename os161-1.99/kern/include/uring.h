@@ -0,0 +1,19 @@
+/*
+ * Asynchronous I/O rings. The shared layout is in <kern/uring.h>.
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+struct uring;
+
+/* Start the I/O threads. */
+void uring_bootstrap(void);
+
+/*
+ * Wait for every request still outstanding on UR and free it. Called
+ * from as_destroy, before the memory the requests use goes away.
+ */
+void uring_destroy(struct uring *ur);
+
+#endif /* _URING_H_ */
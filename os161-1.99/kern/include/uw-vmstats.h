@@ -9,12 +9,10 @@
 /* Virtual memory stats */
 /* Tracks stats on user programs */
 
-/* NOTE !!!!!! WARNING !!!!!
- * All of the functions (except vmstats_print) whose names begin with '_'
- * assume that atomicity is ensured elsewhere
- * (i.e., outside of these routines) by acquiring stats_lock.
- * All of the functions whose names do not begin
- * with '_' ensure atomicity locally (except vmstats_print).
+/* NOTE: The counters are per-cpu, so none of these functions take a
+ * lock and incrementing is cheap enough to leave on all the time.
+ * The functions whose names begin with '_' are the same as the ones
+ * without and are kept for compatibility.
  *
  * Generally you will use the functions whose names
  * do not begin with '_'.
@@ -41,18 +39,18 @@
 /* ----------------------------------------------------------------------- */
 
 /* Initialize the statistics: must be called before using */
-void vmstats_init(void);                     /* uses locking */
-void _vmstats_init(void);                    /* atomicity must be ensured elsewhere */
+void vmstats_init(void);
+void _vmstats_init(void);
 
 /* Increment the specified count 
  * Example use: 
  *   vmstats_inc(VMSTAT_TLB_FAULT);
  *   vmstats_inc(VMSTAT_PAGE_FAULT_ZERO);
  */
-void vmstats_inc(unsigned int index);    /* uses locking */
-void _vmstats_inc(unsigned int index);   /* atomicity must be ensured elsewhere */
+void vmstats_inc(unsigned int index);
+void _vmstats_inc(unsigned int index);
 
 /* Print the statistics: assumes that at least vmstats_init has been called */
-void vmstats_print(void);                    /* Does NOT use locking */
+void vmstats_print(void);
 
 #endif /* VM_STATS_H */
@@ -192,5 +192,17 @@ void vfs_biglock_acquire(void);
 void vfs_biglock_release(void);
 bool vfs_biglock_do_i_hold(void);
 
+/*
+ * Reader-writer lock for the VFS device table and the bootfs vnode.
+ * Path lookups hold it shared; adding devices, mounting, unmounting,
+ * and changing the bootfs hold it exclusive. When both are needed it
+ * must be taken before vfs_biglock.
+ */
+void vfs_devlock_acquire_read(void);
+void vfs_devlock_release_read(void);
+void vfs_devlock_acquire_write(void);
+void vfs_devlock_release_write(void);
+bool vfs_devlock_is_held(void);
+
 
 #endif /* _VFS_H_ */
@@ -33,6 +33,7 @@
 
 struct uio;
 struct stat;
+struct pollwaiter;
 
 /*
  * A struct vnode is an abstract representation of a file.
@@ -50,10 +51,14 @@ struct stat;
  * vn_opencount is managed using VOP_INCOPEN and VOP_DECOPEN by
  * vfs_open() and vfs_close(). Code above the VFS layer should not
  * need to worry about it.
+ *
+ * vn_gen changes after every VOP_WRITE and VOP_TRUNCATE, so caches of
+ * file contents (see loadelf.c) can tell when they have gone stale.
  */
 struct vnode {
 	int vn_refcount;                /* Reference count */
 	int vn_opencount;
+	volatile unsigned vn_gen;       /* Modification generation */
 
 	struct fs *vn_fs;               /* Filesystem vnode belongs to */
 
@@ -120,6 +125,14 @@ struct vnode {
  *                      DATA. The interpretation of the data is specific
  *                      to each ioctl.
  *
+ *    vop_poll        - Set *REVENTS to which of the poll conditions
+ *                      in EVENTS (see kern/poll.h) hold now, plus any
+ *                      of POLLERR and POLLHUP. If none of EVENTS hold
+ *                      and PW is not NULL, add PW to the object's
+ *                      poll queue (see pollq.h) so it is woken when
+ *                      they might. Objects that never block can use
+ *                      vnode_pollready.
+ *
  *    vop_stat        - Return info about a file. The pointer is a 
  *                      pointer to struct stat; see kern/stat.h.
  *
@@ -205,6 +218,8 @@ struct vnode_ops {
 	int (*vop_getdirentry)(struct vnode *dir, struct uio *uio);
 	int (*vop_write)(struct vnode *file, struct uio *uio);
 	int (*vop_ioctl)(struct vnode *object, int op, userptr_t data);
+	int (*vop_poll)(struct vnode *object, int events, int *revents,
+			struct pollwaiter *pw);
 	int (*vop_stat)(struct vnode *object, struct stat *statbuf);
 	int (*vop_gettype)(struct vnode *object, mode_t *result);
 	int (*vop_tryseek)(struct vnode *object, off_t pos);
@@ -248,14 +263,15 @@ struct vnode_ops {
 #define VOP_READ(vn, uio)               (__VOP(vn, read)(vn, uio))
 #define VOP_READLINK(vn, uio)           (__VOP(vn, readlink)(vn, uio))
 #define VOP_GETDIRENTRY(vn, uio)        (__VOP(vn,getdirentry)(vn, uio))
-#define VOP_WRITE(vn, uio)              (__VOP(vn, write)(vn, uio))
+#define VOP_WRITE(vn, uio)  vnode_modified(vn, __VOP(vn, write)(vn, uio))
 #define VOP_IOCTL(vn, code, buf)        (__VOP(vn, ioctl)(vn,code,buf))
+#define VOP_POLL(vn, ev, rev, pw)       (__VOP(vn, poll)(vn, ev, rev, pw))
 #define VOP_STAT(vn, ptr) 	        (__VOP(vn, stat)(vn, ptr))
 #define VOP_GETTYPE(vn, result)         (__VOP(vn, gettype)(vn, result))
 #define VOP_TRYSEEK(vn, pos)            (__VOP(vn, tryseek)(vn, pos))
 #define VOP_FSYNC(vn)                   (__VOP(vn, fsync)(vn))
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
-#define VOP_TRUNCATE(vn, pos)           (__VOP(vn, truncate)(vn, pos))
+#define VOP_TRUNCATE(vn, pos) vnode_modified(vn, __VOP(vn, truncate)(vn, pos))
 #define VOP_NAMEFILE(vn, uio)           (__VOP(vn, namefile)(vn, uio))
 
 #define VOP_CREAT(vn,nm,excl,mode,res)  (__VOP(vn, creat)(vn,nm,excl,mode,res))
@@ -274,6 +290,18 @@ struct vnode_ops {
  */
 void vnode_check(struct vnode *, const char *op);
 
+/*
+ * Bump vn_gen once a write or truncate is done; returns RESULT.
+ */
+int vnode_modified(struct vnode *, int result);
+
+/*
+ * VOP_POLL for objects that are always ready for reading and writing,
+ * such as regular files.
+ */
+int vnode_pollready(struct vnode *, int events, int *revents,
+		    struct pollwaiter *pw);
+
 /*
  * Reference count manipulation (handled above filesystem level)
  */
@@ -36,6 +36,7 @@
 
 
 struct wchan; /* Opaque */
+struct thread;
 
 /*
  * Create a wait channel. Use NAME as a symbolic name for the channel.
@@ -55,6 +56,13 @@ void wchan_destroy(struct wchan *wc);
  */
 bool wchan_isempty(struct wchan *wc);
 
+/*
+ * Return the highest t_priority of the threads sleeping on the
+ * channel, or -1 if there are none. The channel should not already
+ * be locked.
+ */
+int wchan_maxpriority(struct wchan *wc);
+
 /*
  * Lock and unlock the wait channel.
  */
@@ -81,5 +89,24 @@ void wchan_sleep(struct wchan *wc);
 void wchan_wakeone(struct wchan *wc);
 void wchan_wakeall(struct wchan *wc);
 
+/*
+ * Wake up the thread at the head of a wait channel and return it, or
+ * NULL if nobody was sleeping. The queue should not already be locked.
+ *
+ * The returned pointer is only good for identity comparisons (such as
+ * recording the new owner of a lock), and only while the caller holds
+ * some other lock the woken thread must take before it can proceed.
+ */
+struct thread *wchan_wakehead(struct wchan *wc);
+
+/*
+ * Move one thread, or all threads, sleeping on FROM onto the tail of
+ * TO without waking them. Returns the number of threads moved.
+ * Neither queue should already be locked. If MOVED is not NULL, it is
+ * called with ARG on each thread moved, with both queues locked.
+ */
+unsigned wchan_requeue(struct wchan *from, struct wchan *to, bool all,
+		       void (*moved)(struct thread *, void *), void *arg);
+
 
 #endif /* _WCHAN_H_ */
@@ -120,6 +120,50 @@ bitmap_alloc(struct bitmap *b, unsigned *index)
         return ENOSPC;
 }
 
+/*
+ * Like bitmap_alloc, but the search starts at bit START and wraps
+ * around, so callers can hand out indexes round-robin. Full words are
+ * still skipped whole.
+ */
+int
+bitmap_alloc_from(struct bitmap *b, unsigned start, unsigned *index)
+{
+        unsigned maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
+        unsigned startix, startoff;
+        unsigned n, ix, offset;
+
+        if (start >= b->nbits) {
+                start = 0;
+        }
+        startix = start / BITS_PER_WORD;
+        startoff = start % BITS_PER_WORD;
+
+        /* visit the start word twice: once from startoff, once below it */
+        for (n=0; n<=maxix; n++) {
+                ix = (startix + n) % maxix;
+                if (b->v[ix]==WORD_ALLBITS) {
+                        continue;
+                }
+                for (offset = 0; offset < BITS_PER_WORD; offset++) {
+                        WORD_TYPE mask = ((WORD_TYPE)1) << offset;
+
+                        if (n == 0 && offset < startoff) {
+                                continue;
+                        }
+                        if (n == maxix && offset >= startoff) {
+                                break;
+                        }
+                        if ((b->v[ix] & mask)==0) {
+                                b->v[ix] |= mask;
+                                *index = (ix*BITS_PER_WORD)+offset;
+                                KASSERT(*index < b->nbits);
+                                return 0;
+                        }
+                }
+        }
+        return ENOSPC;
+}
+
 static
 inline
 void
@@ -0,0 +1,191 @@
+/*
+ * Kernel statistics registry. See <kstat.h>.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <kstat.h>
+
+/*
+ * The registry is a list in registration order. Statistics are only
+ * ever appended, and a new one is fully set up before it is linked
+ * in, so readers walk the list without taking the lock.
+ */
+static struct spinlock kstat_lock = SPINLOCK_INITIALIZER;
+static struct kstat *kstat_head;
+static struct kstat **kstat_tailp = &kstat_head;
+
+/* Statistics that belong to no subsystem in particular. */
+static int64_t kstat_kheapused(void);
+static struct kstat ks_kheapused =
+	KSTAT_GAUGEFN("kmalloc.bytes_used", kstat_kheapused);
+
+static
+int64_t
+kstat_kheapused(void)
+{
+	return kheap_getused();
+}
+
+void
+kstat_bootstrap(void)
+{
+	kstat_register(&ks_kheapused);
+}
+
+void
+kstat_register(struct kstat *ks)
+{
+	if (ks->ks_registered) {
+		return;
+	}
+
+	spinlock_acquire(&kstat_lock);
+	if (!ks->ks_registered) {
+		KASSERT(ks->ks_type != KSTAT_TYPE_HISTOGRAM ||
+			ks->ks_buckets != NULL);
+		ks->ks_next = NULL;
+		*kstat_tailp = ks;
+		kstat_tailp = &ks->ks_next;
+		ks->ks_registered = true;
+	}
+	spinlock_release(&kstat_lock);
+}
+
+void
+kstat_add(struct kstat *ks, unsigned n)
+{
+	KASSERT(ks->ks_type == KSTAT_TYPE_COUNTER);
+	if (!ks->ks_registered) {
+		kstat_register(ks);
+	}
+	percpu_counter_add(&ks->ks_value, n);
+}
+
+void
+kstat_gauge_add(struct kstat *ks, int delta)
+{
+	KASSERT(ks->ks_type == KSTAT_TYPE_GAUGE);
+	KASSERT(ks->ks_readfn == NULL);
+	if (!ks->ks_registered) {
+		kstat_register(ks);
+	}
+	/* Negative deltas wrap; see kstat_read. */
+	percpu_counter_add(&ks->ks_value, (unsigned)delta);
+}
+
+/*
+ * Histogram bucket for VAL: 0 for 0, otherwise one more than the
+ * index of the highest set bit.
+ */
+static
+unsigned
+kstat_bucket(unsigned val)
+{
+	unsigned b = 0;
+
+	while (val != 0) {
+		b++;
+		val >>= 1;
+	}
+	return b;
+}
+
+void
+kstat_record(struct kstat *ks, unsigned val)
+{
+	KASSERT(ks->ks_type == KSTAT_TYPE_HISTOGRAM);
+	if (!ks->ks_registered) {
+		kstat_register(ks);
+	}
+	percpu_counter_inc(&ks->ks_buckets[kstat_bucket(val)]);
+	percpu_counter_inc(&ks->ks_value);
+}
+
+int64_t
+kstat_read(struct kstat *ks)
+{
+	if (ks->ks_readfn != NULL) {
+		return ks->ks_readfn();
+	}
+	if (ks->ks_type == KSTAT_TYPE_GAUGE) {
+		/*
+		 * The per-cpu slots hold increments and decrements
+		 * mod 2^32; the total, taken mod 2^32, is the signed
+		 * value.
+		 */
+		return (int32_t)(uint32_t)percpu_counter_read(&ks->ks_value);
+	}
+	return percpu_counter_read(&ks->ks_value);
+}
+
+/*
+ * Append formatted text to BUF at *POS, truncating at LEN but
+ * advancing *POS by the full length regardless.
+ */
+static
+void
+kstat_append(char *buf, size_t len, size_t *pos, const char *str)
+{
+	size_t n;
+
+	n = strlen(str);
+	if (*pos < len) {
+		snprintf(buf + *pos, len - *pos, "%s", str);
+	}
+	*pos += n;
+}
+
+size_t
+kstat_format(char *buf, size_t len)
+{
+	static const char *const typenames[] = {
+		"counter", "gauge", "histogram",
+	};
+	struct kstat *ks;
+	char tmp[64];
+	size_t pos = 0;
+	uint64_t n;
+	unsigned i;
+
+	if (len > 0) {
+		buf[0] = 0;
+	}
+	for (ks = kstat_head; ks != NULL; ks = ks->ks_next) {
+		snprintf(tmp, sizeof(tmp), "%s %s %lld", ks->ks_name,
+			 typenames[ks->ks_type], kstat_read(ks));
+		kstat_append(buf, len, &pos, tmp);
+		if (ks->ks_type == KSTAT_TYPE_HISTOGRAM) {
+			/* nonzero buckets, keyed by their lower bound */
+			for (i=0; i<KSTAT_NBUCKETS; i++) {
+				n = percpu_counter_read(&ks->ks_buckets[i]);
+				if (n == 0) {
+					continue;
+				}
+				snprintf(tmp, sizeof(tmp), " %lu:%llu",
+					 i == 0 ? 0UL : 1UL << (i-1), n);
+				kstat_append(buf, len, &pos, tmp);
+			}
+		}
+		kstat_append(buf, len, &pos, "\n");
+	}
+	return pos;
+}
+
+void
+kstat_print(void)
+{
+	char *buf;
+	size_t len;
+
+	len = kstat_format(NULL, 0) + 1;
+	buf = kmalloc(len);
+	if (buf == NULL) {
+		kprintf("kstat: out of memory\n");
+		return;
+	}
+	kstat_format(buf, len);
+	kprintf("%s", buf);
+	kfree(buf);
+}
@@ -52,6 +52,11 @@
 #include <kern/fcntl.h>
 #if OPT_A2
 #include <limits.h>
+#include <wchan.h>
+#include <bitmap.h>
+#include <kern/errno.h>
+#include <kern/wait.h>
+#include <file.h>
 #include <debug.h>
 #endif
 
@@ -75,26 +80,88 @@ struct semaphore *no_proc_sem;
 
 
 #if OPT_A2
-static volatile pid_t pid_count = PID_MIN;
+/*
+ * Pids in use, including those of exited processes whose status has
+ * not been reaped yet. Allocation starts at pid_next and wraps, so a
+ * freed pid is not handed out again until the rest have been cycled
+ * through.
+ */
+struct rwlock* lk_process_table;
+static struct bitmap* pid_bitmap;
+static pid_t pid_next = PID_MIN;
+
+/* pid -> process_status; PID_HASHSIZE must be a power of 2 */
+#define PID_HASHSIZE 1024
+#define PID_HASH(pid) ((unsigned)(pid) & (PID_HASHSIZE - 1))
+static struct process_status* pid_hash[PID_HASHSIZE];
+
+/*
+ * The console, shared as stdin/stdout/stderr by all processes. It is
+ * opened by the first process to need it (devices aren't attached yet
+ * at proc_bootstrap) and its own reference is never dropped, so it
+ * stays open for the life of the system.
+ */
+static struct openfile *console_file;
+static struct lock *console_lock;	/* for opening console_file */
+
+static void process_table_bootstrap(void) {
+   pid_bitmap = bitmap_create(PID_MAX);
+   lk_process_table = rwlock_create("process_table");
+   if (pid_bitmap == NULL || lk_process_table == NULL) {
+      panic("could not create the process table\n");
+   }
+   // pids below PID_MIN are never handed out
+   for (pid_t i = 0; i < PID_MIN; i++) {
+      bitmap_mark(pid_bitmap, i);
+   }
+}
 
-void save_process_status(pid_t new, pid_t parent) {
-   KASSERT(lock_do_i_hold(lk_process_table));
+int save_process_status(struct process_status* parent,
+                        struct process_status** newps) {
+   KASSERT(rwlock_do_i_hold_write(lk_process_table));
+   unsigned index;
+   if (bitmap_alloc_from(pid_bitmap, pid_next, &index)) {
+      return ENPROC;
+   }
    struct process_status* ps = kmalloc(sizeof(struct process_status));
-   ps->pid = new;
-   ps->parent = parent;
+   if (! ps) {
+      bitmap_unmark(pid_bitmap, index);
+      return ENOMEM;
+   }
+   ps->ps_wchan = wchan_create("waitpid");
+   if (! ps->ps_wchan) {
+      kfree(ps);
+      bitmap_unmark(pid_bitmap, index);
+      return ENOMEM;
+   }
+   pid_next = (index + 1 < PID_MAX) ? (pid_t)(index + 1) : PID_MIN;
+   ps->pid = index;
    ps->valid = true;
    ps->exitcode = -1;
-   ps->cv_waitpid = cv_create("");
-   array_add(process_table, ps, NULL);
+   spinlock_init(&ps->ps_lock);
+   ps->ps_hashnext = pid_hash[PID_HASH(ps->pid)];
+   pid_hash[PID_HASH(ps->pid)] = ps;
+   ps->ps_children = NULL;
+   if (parent) {
+      ps->parent = parent->pid;
+      ps->ps_sibling = parent->ps_children;
+      parent->ps_children = ps;
+   } else {
+      ps->parent = 0;
+      ps->ps_sibling = NULL;
+   }
+   *newps = ps;
+   return 0;
 }
 
 struct process_status* get_process_status(pid_t pid) {
-   KASSERT(lock_do_i_hold(lk_process_table));
-   unsigned len = array_num(process_table);
-   for (unsigned i = 0; i < len; i++) {
-      struct process_status* ps = array_get(process_table, i);
-      // wake parents
-      if (ps && ps->pid == pid) {
+   KASSERT(rwlock_is_held(lk_process_table));
+   if (pid < PID_MIN || pid >= PID_MAX) {
+      return NULL;
+   }
+   struct process_status* ps;
+   for (ps = pid_hash[PID_HASH(pid)]; ps; ps = ps->ps_hashnext) {
+      if (ps->pid == pid) {
          return ps;
       }
    }
@@ -102,12 +169,142 @@ struct process_status* get_process_status(pid_t pid) {
 }
 
 void process_status_destroy(struct process_status* ps) {
-   KASSERT(lock_do_i_hold(lk_process_table));
+   KASSERT(rwlock_do_i_hold_write(lk_process_table));
+   KASSERT(ps->ps_children == NULL);
+   struct process_status** pp;
+   if (ps->parent != 0) {
+      struct process_status* parent = get_process_status(ps->parent);
+      KASSERT(parent);
+      pp = &parent->ps_children;
+      while (*pp != ps) {
+         KASSERT(*pp);
+         pp = &(*pp)->ps_sibling;
+      }
+      *pp = ps->ps_sibling;
+   }
+   pp = &pid_hash[PID_HASH(ps->pid)];
+   while (*pp != ps) {
+      KASSERT(*pp);
+      pp = &(*pp)->ps_hashnext;
+   }
+   *pp = ps->ps_hashnext;
+   bitmap_unmark(pid_bitmap, ps->pid);
    ps->pid = 0;
    ps->parent = 0;
    ps->valid = 0;
    ps->exitcode = 0;
-   cv_destroy(ps->cv_waitpid);
+   ps->ps_hashnext = NULL;
+   ps->ps_sibling = NULL;
+   spinlock_cleanup(&ps->ps_lock);
+   wchan_destroy(ps->ps_wchan);
+   kfree(ps);
+}
+
+void process_table_exit(struct process_status* self, int waitcode) {
+   rwlock_acquire_write(lk_process_table);
+   KASSERT(self->valid);
+   // reap exited children, orphan running ones
+   struct process_status* ps = self->ps_children;
+   self->ps_children = NULL;
+   while (ps) {
+      struct process_status* next = ps->ps_sibling;
+      KASSERT(ps->parent == self->pid);
+      ps->parent = 0;
+      ps->ps_sibling = NULL;
+      if (! ps->valid) {
+         process_status_destroy(ps);
+      }
+      ps = next;
+   }
+   if (self->parent == 0) {
+      // nobody can wait for us
+      process_status_destroy(self);
+   } else {
+      process_status_exit(self, waitcode);
+   }
+   rwlock_release_write(lk_process_table);
+}
+
+void process_status_exit(struct process_status* ps, int exitcode) {
+   KASSERT(rwlock_do_i_hold_write(lk_process_table));
+   ps->exitcode = exitcode;
+   ps->valid = false;
+   // wake our parent only, if it is waiting
+   struct process_status* parent = get_process_status(ps->parent);
+   KASSERT(parent);
+   spinlock_acquire(&parent->ps_lock);
+   wchan_wakeall(parent->ps_wchan);
+   spinlock_release(&parent->ps_lock);
+}
+
+int process_table_wait(struct process_status* self, pid_t pid, int options,
+                       pid_t* reaped, int* exitcode) {
+   struct process_status* ps;
+   rwlock_acquire_read(lk_process_table);
+   if (pid != -1) {
+      ps = get_process_status(pid);
+      if (! ps) {
+         rwlock_release_read(lk_process_table);
+         return ESRCH;
+      }
+      if (ps->parent != self->pid) {
+         rwlock_release_read(lk_process_table);
+         return ECHILD;
+      }
+   } else if (self->ps_children == NULL) {
+      rwlock_release_read(lk_process_table);
+      return ECHILD;
+   }
+   while (1) {
+      // find an exited child we are interested in
+      if (pid != -1) {
+         ps = get_process_status(pid);
+         KASSERT(ps && ps->parent == self->pid);
+         if (ps->valid) {
+            ps = NULL;
+         }
+      } else {
+         for (ps = self->ps_children; ps; ps = ps->ps_sibling) {
+            if (! ps->valid) {
+               break;
+            }
+         }
+      }
+      if (ps) {
+         break;
+      }
+      if (options & WNOHANG) {
+         *reaped = 0;
+         rwlock_release_read(lk_process_table);
+         return 0;
+      }
+      /*
+       * Children mark themselves exited with the table locked for
+       * writing and then wake our ps_wchan under ps_lock, so taking
+       * ps_lock and the wchan before letting go of the table closes
+       * the window for a missed wakeup.
+       */
+      spinlock_acquire(&self->ps_lock);
+      wchan_lock(self->ps_wchan);
+      rwlock_release_read(lk_process_table);
+      spinlock_release(&self->ps_lock);
+      wchan_sleep(self->ps_wchan);
+      rwlock_acquire_read(lk_process_table);
+   }
+   /*
+    * Reaping changes the table, so trade the read hold for a write
+    * one. Nobody but us reaps our children, so ps is still there.
+    */
+   pid = ps->pid;
+   rwlock_release_read(lk_process_table);
+   rwlock_acquire_write(lk_process_table);
+   ps = get_process_status(pid);
+   KASSERT(ps && ps->parent == self->pid && ! ps->valid);
+   *reaped = ps->pid;
+   *exitcode = ps->exitcode;
+   process_status_destroy(ps);
+   rwlock_release_write(lk_process_table);
+   return 0;
 }
 #endif
 
@@ -139,10 +336,19 @@ proc_create(const char *name)
    /* VFS fields */
    proc->p_cwd = NULL;
 
-#ifdef UW
+#if OPT_A2
+   proc->p_filetable = NULL;
+#elif defined(UW)
    proc->console = NULL;
 #endif // UW
 
+#if OPT_A2
+   proc->pid = 0;
+   proc->ps = NULL;
+   proc->p_vforkparent = NULL;
+   proc->p_vforksem = NULL;
+#endif
+
    return proc;
 }
 
@@ -165,25 +371,17 @@ proc_destroy(struct proc *proc)
    KASSERT(proc != kproc);
 
 #if OPT_A2
-   // if was last elem, destroy table
-   P(proc_count_mutex);
-   if (proc_count == 0) {
-      lock_acquire(lk_process_table);
-      while (array_num(process_table) > 0) {
-         unsigned i = array_num(process_table) - 1;
-         struct process_status* ps = array_get(process_table, i);
-         KASSERT(ps);
-         KASSERT(ps->pid == proc->pid || ps->parent == proc->pid);
-         process_status_destroy(ps);
-         array_remove(process_table, i);
-      }
-      array_destroy(process_table);
-      lock_release(lk_process_table);
-      lock_destroy(lk_process_table);
-      process_table = NULL;
-      lk_process_table = NULL;
+   /*
+    * A process that never got as far as _exit (fork failed part way)
+    * still holds a live status; nobody will ever wait for it.
+    */
+   if (proc->ps != NULL) {
+      rwlock_acquire_write(lk_process_table);
+      KASSERT(proc->ps->valid);
+      process_status_destroy(proc->ps);
+      rwlock_release_write(lk_process_table);
+      proc->ps = NULL;
    }
-   V(proc_count_mutex);
 #endif
 
    /*
@@ -219,12 +417,24 @@ proc_destroy(struct proc *proc)
    }
 #endif // UW
 
-#ifdef UW
+#if OPT_A2
+   if (proc->p_filetable) {
+      filetable_destroy(proc->p_filetable);
+      proc->p_filetable = NULL;
+   }
+#elif defined(UW)
    if (proc->console) {
       vfs_close(proc->console);
    }
 #endif // UW
 
+#if OPT_A2
+   KASSERT(proc->p_vforkparent == NULL);
+   if (proc->p_vforksem) {
+      sem_destroy(proc->p_vforksem);
+   }
+#endif
+
    threadarray_cleanup(&proc->p_threads);
    spinlock_cleanup(&proc->p_lock);
 
@@ -268,7 +478,44 @@ proc_bootstrap(void)
       panic("could not create no_proc_sem semaphore\n");
    }
 #endif // UW 
+#if OPT_A2
+   process_table_bootstrap();
+   console_lock = lock_create("console_file");
+   if (console_lock == NULL) {
+      panic("could not create console_lock\n");
+   }
+#endif
+}
+
+#if OPT_A2
+/*
+ * Make a descriptor table with the console on fds 0, 1 and 2.
+ */
+static int proc_stdio(struct filetable **ret) {
+   int result = 0;
+   lock_acquire(console_lock);
+   if (console_file == NULL) {
+      char path[] = "con:";
+      result = openfile_open(path, O_RDWR, 0, &console_file);
+   }
+   lock_release(console_lock);
+   if (result) {
+      return result;
+   }
+   struct filetable *ft = filetable_create();
+   if (! ft) {
+      return ENOMEM;
+   }
+   for (int i = 0; i < 3; i++) {
+      int fd;
+      openfile_incref(console_file);
+      result = filetable_place(ft, console_file, &fd);
+      KASSERT(result == 0 && fd == i);
+   }
+   *ret = ft;
+   return 0;
 }
+#endif
 
 /*
  * Create a fresh proc for use by runprogram.
@@ -280,14 +527,35 @@ struct proc *
 proc_create_runprogram(const char *name)
 {
    struct proc *proc;
+#if !OPT_A2
    char *console_path;
+#endif
 
    proc = proc_create(name);
    if (proc == NULL) {
       return NULL;
    }
 
-#ifdef UW
+#if OPT_A2
+   /*
+    * Share the parent's open files. Programs started from the menu get
+    * the console as stdin, stdout and stderr instead; every such process
+    * shares one console openfile, opened on first use.
+    */
+   int result;
+   if (curproc->p_filetable) {
+      result = filetable_copy(curproc->p_filetable, &proc->p_filetable);
+   } else {
+      result = proc_stdio(&proc->p_filetable);
+   }
+   if (result) {
+      kfree(proc->p_name);
+      threadarray_cleanup(&proc->p_threads);
+      spinlock_cleanup(&proc->p_lock);
+      kfree(proc);
+      return NULL;
+   }
+#elif defined(UW)
    /* open the console - this should always succeed */
    console_path = kstrdup("con:");
    if (console_path == NULL) {
@@ -322,32 +590,6 @@ proc_create_runprogram(const char *name)
    spinlock_release(&curproc->p_lock);
 #endif // UW
 
-#if OPT_A2
-   
-   P(proc_count_mutex);
-   const unsigned cur_proc_count = proc_count;
-   V(proc_count_mutex);
-   
-   // create process_table
-   if (cur_proc_count == 0) {
-      proc->pid = PID_MIN;
-      process_table = array_create();
-      lk_process_table = lock_create("");
-      lock_acquire(lk_process_table);
-      save_process_status(proc->pid, 0);
-      lock_release(lk_process_table);
-   } else {
-      lock_acquire(lk_process_table);
-      for (pid_t i = PID_MIN; i < PID_MAX; i++) {
-         if (! get_process_status(i)) {
-            proc->pid = i;
-            break;
-         }
-      }
-      save_process_status(proc->pid, curproc->pid);
-      lock_release(lk_process_table);
-   }  
-#endif
 
 #ifdef UW
    /* increment the count of processes */
@@ -358,6 +600,20 @@ proc_create_runprogram(const char *name)
    V(proc_count_mutex);
 #endif // UW
 
+#if OPT_A2
+   // the kernel menu has no status, so its children start out as orphans
+   struct process_status* ps;
+   rwlock_acquire_write(lk_process_table);
+   result = save_process_status(curproc->ps, &ps);
+   rwlock_release_write(lk_process_table);
+   if (result) {
+      proc_destroy(proc);
+      return NULL;
+   }
+   proc->pid = ps->pid;
+   proc->ps = ps;
+#endif
+
    return proc;
 }
 
@@ -451,3 +707,18 @@ curproc_setas(struct addrspace *newas)
    spinlock_release(&proc->p_lock);
    return oldas;
 }
+
+#if OPT_A2
+bool
+proc_vfork_release(struct proc *p)
+{
+   struct proc *parent = p->p_vforkparent;
+
+   if (parent == NULL) {
+      return false;
+   }
+   p->p_vforkparent = NULL;
+   V(parent->p_vforksem);
+   return true;
+}
+#endif
@@ -42,14 +42,21 @@
 #include <proc.h>
 #include <current.h>
 #include <synch.h>
+#include <kstat.h>
 #include <vm.h>
+#include <addrspace.h>
 #include <mainbus.h>
 #include <vfs.h>
 #include <device.h>
 #include <syscall.h>
+#include <kdata.h>
 #include <test.h>
 #include <version.h>
 #include "autoconf.h"  // for pseudoconfig
+#include "opt-A2.h"
+#if OPT_A2
+#include <uring.h>
+#endif
 
 
 /*
@@ -109,6 +116,7 @@ boot(void)
 	ram_bootstrap();
 	proc_bootstrap();
 	thread_bootstrap();
+	kstat_bootstrap();
 	hardclock_bootstrap();
 	vfs_bootstrap();
 
@@ -123,7 +131,12 @@ boot(void)
 
 	/* Late phase of initialization. */
 	vm_bootstrap();
+	kdata_bootstrap();
+	execcache_bootstrap();
 	kprintf_bootstrap();
+#if OPT_A2
+	uring_bootstrap();
+#endif
 	thread_start_cpus();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
@@ -42,9 +42,14 @@
 #include <sfs.h>
 #include <syscall.h>
 #include <test.h>
+#include <kstat.h>
 #include "opt-synchprobs.h"
 #include "opt-sfs.h"
 #include "opt-net.h"
+#include "opt-lockstat.h"
+#if OPT_LOCKSTAT
+#include <lockstat.h>
+#endif
 
 /*
  * In-kernel menu and command dispatcher.
@@ -396,6 +401,85 @@ cmd_kheapstats(int nargs, char **args)
 	return 0;
 }
 
+#if OPT_LOCKSTAT
+/*
+ * Command for lock contention profiling.
+ *   lockstat on|off|clear  - start or stop collecting, or zero the counts
+ *   lockstat [N]           - show the N (default 20) most waited-on locks
+ */
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	if (nargs > 2) {
+		kprintf("Usage: lockstat [on|off|clear|N]\n");
+		return EINVAL;
+	}
+	if (nargs == 1) {
+		lockstat_print(20);
+	}
+	else if (!strcmp(args[1], "on")) {
+		lockstat_enable(true);
+	}
+	else if (!strcmp(args[1], "off")) {
+		lockstat_enable(false);
+	}
+	else if (!strcmp(args[1], "clear")) {
+		lockstat_clear();
+	}
+	else if (atoi(args[1]) > 0) {
+		lockstat_print(atoi(args[1]));
+	}
+	else {
+		kprintf("Usage: lockstat [on|off|clear|N]\n");
+		return EINVAL;
+	}
+	return 0;
+}
+#endif /* OPT_LOCKSTAT */
+
+static
+int
+cmd_kstat(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	kstat_print();
+
+	return 0;
+}
+
+/*
+ * Command for showing or setting the per-cpu thread pool size.
+ */
+static
+int
+cmd_tpool(int nargs, char **args)
+{
+	const char *p;
+	int max;
+
+	if (nargs == 2) {
+		/* digits only; atoi would take "-1" and the cap would wrap */
+		for (p = args[1]; *p >= '0' && *p <= '9'; p++) {
+			/* nothing */
+		}
+		max = atoi(args[1]);
+		if (p == args[1] || *p != 0 || max < 0) {
+			kprintf("Usage: tpool [max]\n");
+			return EINVAL;
+		}
+		thread_poolmax = max;
+	}
+	else if (nargs != 1) {
+		kprintf("Usage: tpool [max]\n");
+		return EINVAL;
+	}
+	kprintf("Thread pool: up to %u threads per cpu\n", thread_poolmax);
+	return 0;
+}
+
 static int cmd_dth(int n, char **args) {
 	(void)n;
 	(void)args;
@@ -472,6 +556,9 @@ static const char *testmenu[] = {
 	"[sy1] Semaphore test                ",
 	"[sy2] Lock test             (1)     ",
 	"[sy3] CV test               (1)     ",
+	"[sy4] RW lock test                  ",
+	"[sy5] Spinlock benchmark            ",
+	"[sy6] Priority inheritance test     ",
 #ifdef UW
 	"[uw1] UW lock test          (1)     ",
 	"[uw2] UW vmstats test       (3)     ",
@@ -512,6 +599,11 @@ static const char *mainmenu[] = {
 #endif /* UW */
 #endif
 	"[kh] Kernel heap stats              ",
+	"[kstat] Kernel statistics           ",
+	"[tpool] Thread pool size            ",
+#if OPT_LOCKSTAT
+	"[lockstat] Lock contention stats    ",
+#endif
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -572,6 +664,11 @@ static struct {
 
 	/* stats */
 	{ "kh",         cmd_kheapstats },
+	{ "kstat",	cmd_kstat },
+	{ "tpool",	cmd_tpool },
+#if OPT_LOCKSTAT
+	{ "lockstat",	cmd_lockstat },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -589,6 +686,9 @@ static struct {
 	/* synchronization assignment tests */
 	{ "sy2",	locktest },
 	{ "sy3",	cvtest },
+	{ "sy4",	rwtest },
+	{ "sy5",	spinlocktest },
+	{ "sy6",	pitest },
 #ifdef UW
 	{ "uw1",	uwlocktest1 },
 	{ "uw2",	uwvmstatstest },
@@ -0,0 +1,262 @@
+/*
+ * Open files and file descriptor tables. See <file.h>.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <current.h>
+#include <proc.h>
+#include <stat.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <file.h>
+
+int
+openfile_create(struct vnode *vn, int openflags, struct openfile **ret)
+{
+	struct openfile *of;
+
+	of = kmalloc(sizeof(*of));
+	if (of == NULL) {
+		return ENOMEM;
+	}
+	of->of_offsetlock = lock_create("openfile");
+	if (of->of_offsetlock == NULL) {
+		kfree(of);
+		return ENOMEM;
+	}
+
+	of->of_vnode = vn;
+	of->of_accmode = openflags & O_ACCMODE;
+	of->of_append = (openflags & O_APPEND) != 0;
+	of->of_seekable = VOP_TRYSEEK(vn, 0) == 0;
+	of->of_offset = 0;
+	spinlock_init(&of->of_reflock);
+	of->of_refcount = 1;
+
+	*ret = of;
+	return 0;
+}
+
+int
+openfile_open(char *path, int openflags, mode_t mode, struct openfile **ret)
+{
+	struct vnode *vn;
+	int result;
+
+	result = vfs_open(path, openflags, mode, &vn);
+	if (result) {
+		return result;
+	}
+	result = openfile_create(vn, openflags, ret);
+	if (result) {
+		vfs_close(vn);
+		return result;
+	}
+	return 0;
+}
+
+void
+openfile_incref(struct openfile *of)
+{
+	spinlock_acquire(&of->of_reflock);
+	of->of_refcount++;
+	spinlock_release(&of->of_reflock);
+}
+
+void
+openfile_decref(struct openfile *of)
+{
+	bool last;
+
+	spinlock_acquire(&of->of_reflock);
+	KASSERT(of->of_refcount > 0);
+	of->of_refcount--;
+	last = (of->of_refcount == 0);
+	spinlock_release(&of->of_reflock);
+
+	if (!last) {
+		return;
+	}
+	vfs_close(of->of_vnode);
+	lock_destroy(of->of_offsetlock);
+	spinlock_cleanup(&of->of_reflock);
+	kfree(of);
+}
+
+int
+openfile_io(struct openfile *of, struct iovec *iov, int iovcnt, size_t total,
+	    const off_t *pos, enum uio_rw rw, enum uio_seg seg, int *retval)
+{
+	struct stat st;
+	struct uio u;
+	bool uselock;
+	int result;
+
+	if (of->of_accmode == (rw == UIO_READ ? O_WRONLY : O_RDONLY)) {
+		return EBADF;
+	}
+	if (pos != NULL) {
+		if (!of->of_seekable) {
+			return ESPIPE;
+		}
+		if (*pos < 0) {
+			return EINVAL;
+		}
+	}
+
+	uselock = (pos == NULL && of->of_seekable);
+	if (uselock) {
+		lock_acquire(of->of_offsetlock);
+	}
+	if (uselock && rw == UIO_WRITE && of->of_append) {
+		result = VOP_STAT(of->of_vnode, &st);
+		if (result) {
+			lock_release(of->of_offsetlock);
+			return result;
+		}
+		of->of_offset = st.st_size;
+	}
+
+	u.uio_iov = iov;
+	u.uio_iovcnt = iovcnt;
+	if (pos != NULL) {
+		u.uio_offset = *pos;
+	}
+	else if (of->of_seekable) {
+		u.uio_offset = of->of_offset;
+	}
+	else {
+		spinlock_acquire(&of->of_reflock);
+		u.uio_offset = of->of_offset;
+		spinlock_release(&of->of_reflock);
+	}
+	u.uio_resid = total;
+	u.uio_segflg = seg;
+	u.uio_rw = rw;
+	u.uio_space = (seg == UIO_USERSPACE) ? curproc->p_addrspace : NULL;
+
+	result = (rw == UIO_READ) ? VOP_READ(of->of_vnode, &u)
+		: VOP_WRITE(of->of_vnode, &u);
+	if (uselock) {
+		if (result == 0) {
+			of->of_offset = u.uio_offset;
+		}
+		lock_release(of->of_offsetlock);
+	}
+	else if (pos == NULL && result == 0) {
+		/* by what moved, since others may have moved it meanwhile */
+		spinlock_acquire(&of->of_reflock);
+		of->of_offset += total - u.uio_resid;
+		spinlock_release(&of->of_reflock);
+	}
+	if (result) {
+		return result;
+	}
+
+	/* pass back the number of bytes actually transferred */
+	*retval = total - u.uio_resid;
+	KASSERT(*retval >= 0);
+	return 0;
+}
+
+struct filetable *
+filetable_create(void)
+{
+	struct filetable *ft;
+	unsigned i;
+
+	ft = kmalloc(sizeof(*ft));
+	if (ft == NULL) {
+		return NULL;
+	}
+	for (i=0; i<OPEN_MAX; i++) {
+		ft->ft_files[i] = NULL;
+	}
+	return ft;
+}
+
+void
+filetable_destroy(struct filetable *ft)
+{
+	unsigned i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] != NULL) {
+			openfile_decref(ft->ft_files[i]);
+			ft->ft_files[i] = NULL;
+		}
+	}
+	kfree(ft);
+}
+
+int
+filetable_copy(struct filetable *src, struct filetable **ret)
+{
+	struct filetable *ft;
+	unsigned i;
+
+	ft = filetable_create();
+	if (ft == NULL) {
+		return ENOMEM;
+	}
+	for (i=0; i<OPEN_MAX; i++) {
+		ft->ft_files[i] = src->ft_files[i];
+		if (ft->ft_files[i] != NULL) {
+			openfile_incref(ft->ft_files[i]);
+		}
+	}
+	*ret = ft;
+	return 0;
+}
+
+int
+filetable_place(struct filetable *ft, struct openfile *of, int *fd)
+{
+	unsigned i;
+
+	for (i=0; i<OPEN_MAX; i++) {
+		if (ft->ft_files[i] == NULL) {
+			ft->ft_files[i] = of;
+			*fd = i;
+			return 0;
+		}
+	}
+	return EMFILE;
+}
+
+int
+filetable_get(struct filetable *ft, int fd, struct openfile **ret)
+{
+	if (fd < 0 || fd >= OPEN_MAX || ft->ft_files[fd] == NULL) {
+		return EBADF;
+	}
+	*ret = ft->ft_files[fd];
+	return 0;
+}
+
+int
+filetable_remove(struct filetable *ft, int fd, struct openfile **ret)
+{
+	int result;
+
+	result = filetable_get(ft, fd, ret);
+	if (result) {
+		return result;
+	}
+	ft->ft_files[fd] = NULL;
+	return 0;
+}
+
+void
+filetable_placeat(struct filetable *ft, struct openfile *of, int fd,
+		  struct openfile **old)
+{
+	KASSERT(fd >= 0 && fd < OPEN_MAX);
+	*old = ft->ft_files[fd];
+	ft->ft_files[fd] = of;
+}
@@ -8,7 +8,729 @@
 #include <vfs.h>
 #include <current.h>
 #include <proc.h>
+#include "opt-A2.h"
+#if OPT_A2
+#include <kern/fcntl.h>
+#include <kern/seek.h>
+#include <stat.h>
+#include <limits.h>
+#include <copyinout.h>
+#include <synch.h>
+#include <kern/poll.h>
+#include <clock.h>
+#include <file.h>
+#include <pipe.h>
+#include <pollq.h>
+#endif
 
+#if OPT_A2
+/*
+ * Look up fdesc in the current process's table.
+ */
+static int
+file_get(int fdesc, struct openfile **ret)
+{
+  KASSERT(curproc != NULL);
+  KASSERT(curproc->p_filetable != NULL);
+  return filetable_get(curproc->p_filetable, fdesc, ret);
+}
+
+/*
+ * Copy a user pathname into a new kernel buffer.
+ */
+static int
+file_copyinpath(userptr_t upath, char **ret)
+{
+  char *path;
+  int res;
+
+  path = kmalloc(PATH_MAX);
+  if (path == NULL) {
+    return ENOMEM;
+  }
+  res = copyinstr(upath, path, PATH_MAX, NULL);
+  if (res) {
+    kfree(path);
+    return res;
+  }
+  *ret = path;
+  return 0;
+}
+
+/*
+ * Look up fdesc and do the transfer; see openfile_io.
+ */
+static int
+file_io(int fdesc, struct iovec *iov, int iovcnt, size_t total,
+        const off_t *pos, enum uio_rw rw, enum uio_seg seg, int *retval)
+{
+  struct openfile *of;
+  int res;
+
+  res = file_get(fdesc, &of);
+  if (res) {
+    return res;
+  }
+  return openfile_io(of, iov, iovcnt, total, pos, rw, seg, retval);
+}
+
+/*
+ * read, write, pread and pwrite: a single user buffer, at *pos or at
+ * the file offset if pos is NULL.
+ */
+static int
+file_rw(int fdesc, userptr_t ubuf, size_t nbytes, const off_t *pos,
+        enum uio_rw rw, int *retval)
+{
+  struct iovec iov;
+
+  iov.iov_ubase = ubuf;
+  iov.iov_len = nbytes;
+  return file_io(fdesc, &iov, 1, nbytes, pos, rw, UIO_USERSPACE, retval);
+}
+
+/* the byte count comes back in an int, so cap the total there */
+#define IOV_TOTAL_MAX 0x7fffffffU
+
+/*
+ * Common code for the vectored calls: copy in the user's iovec array
+ * and hand it to file_io as-is, so the filesystem sees every buffer
+ * in one uio instead of one call per buffer.
+ */
+static int
+file_rwv(int fdesc, userptr_t uiov, int iovcnt, const off_t *pos,
+         enum uio_rw rw, int *retval)
+{
+  struct iovec *iov;
+  size_t total;
+  int i, res;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX) {
+    return EINVAL;
+  }
+  iov = kmalloc(iovcnt * sizeof(struct iovec));
+  if (iov == NULL) {
+    return ENOMEM;
+  }
+  res = copyin(uiov, iov, iovcnt * sizeof(struct iovec));
+  if (res) {
+    kfree(iov);
+    return res;
+  }
+
+  total = 0;
+  for (i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len > IOV_TOTAL_MAX - total) {
+      kfree(iov);
+      return EINVAL;
+    }
+    total += iov[i].iov_len;
+  }
+
+  res = file_io(fdesc, iov, iovcnt, total, pos, rw, UIO_USERSPACE, retval);
+  kfree(iov);
+  return res;
+}
+
+/* every flag open() understands */
+#define OPEN_FLAGS (O_ACCMODE|O_CREAT|O_EXCL|O_TRUNC|O_APPEND|O_NOCTTY)
+
+int
+sys_open(userptr_t upath, int flags, mode_t mode, int *retval)
+{
+  struct openfile *of;
+  char *path;
+  int res;
+
+  DEBUG(DB_SYSCALL,"Syscall: open(%x,%d)\n",(unsigned int)upath,flags);
+
+  if ((flags & O_ACCMODE) == O_ACCMODE || (flags & ~OPEN_FLAGS) != 0) {
+    return EINVAL;
+  }
+  res = file_copyinpath(upath, &path);
+  if (res) {
+    return res;
+  }
+  res = openfile_open(path, flags, mode, &of);
+  kfree(path);
+  if (res) {
+    return res;
+  }
+  res = filetable_place(curproc->p_filetable, of, retval);
+  if (res) {
+    openfile_decref(of);
+    return res;
+  }
+  return 0;
+}
+
+int
+sys_read(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: read(%d,%x,%d)\n",fdesc,(unsigned int)ubuf,nbytes);
+  return file_rw(fdesc, ubuf, nbytes, NULL, UIO_READ, retval);
+}
+
+/* handler for write() system call                  */
+int
+sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: write(%d,%x,%d)\n",fdesc,(unsigned int)ubuf,nbytes);
+  return file_rw(fdesc, ubuf, nbytes, NULL, UIO_WRITE, retval);
+}
+
+/*
+ * pread and pwrite never look at or lock the shared offset, so
+ * processes sharing one open file can work on disjoint ranges of it
+ * at the same time.
+ */
+int
+sys_pread(int fdesc, userptr_t ubuf, size_t nbytes, off_t pos, int *retval)
+{
+  return file_rw(fdesc, ubuf, nbytes, &pos, UIO_READ, retval);
+}
+
+int
+sys_pwrite(int fdesc, userptr_t ubuf, size_t nbytes, off_t pos, int *retval)
+{
+  return file_rw(fdesc, ubuf, nbytes, &pos, UIO_WRITE, retval);
+}
+
+int
+sys_readv(int fdesc, userptr_t uiov, int iovcnt, int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: readv(%d,%x,%d)\n",fdesc,(unsigned int)uiov,iovcnt);
+  return file_rwv(fdesc, uiov, iovcnt, NULL, UIO_READ, retval);
+}
+
+int
+sys_writev(int fdesc, userptr_t uiov, int iovcnt, int *retval)
+{
+  DEBUG(DB_SYSCALL,"Syscall: writev(%d,%x,%d)\n",fdesc,(unsigned int)uiov,iovcnt);
+  return file_rwv(fdesc, uiov, iovcnt, NULL, UIO_WRITE, retval);
+}
+
+int
+sys_preadv(int fdesc, userptr_t uiov, int iovcnt, off_t pos, int *retval)
+{
+  return file_rwv(fdesc, uiov, iovcnt, &pos, UIO_READ, retval);
+}
+
+int
+sys_pwritev(int fdesc, userptr_t uiov, int iovcnt, off_t pos, int *retval)
+{
+  return file_rwv(fdesc, uiov, iovcnt, &pos, UIO_WRITE, retval);
+}
+
+int
+sys_lseek(int fdesc, off_t pos, int whence, off_t *retval)
+{
+  struct openfile *of;
+  struct stat st;
+  mode_t type;
+  bool isdir = false;
+  off_t newpos;
+  int res;
+
+  res = file_get(fdesc, &of);
+  if (res) {
+    return res;
+  }
+  if (!of->of_seekable) {
+    /*
+     * Directories don't support VOP_TRYSEEK, but their offset is the
+     * getdirentry cookie and may be read and set like any other. A
+     * bad cookie is caught by the filesystem on the next getdirentry.
+     */
+    res = VOP_GETTYPE(of->of_vnode, &type);
+    if (res) {
+      return res;
+    }
+    if (type != S_IFDIR) {
+      return ESPIPE;
+    }
+    isdir = true;
+  }
+
+  lock_acquire(of->of_offsetlock);
+  switch (whence) {
+  case SEEK_SET:
+    newpos = pos;
+    break;
+  case SEEK_CUR:
+    newpos = of->of_offset + pos;
+    break;
+  case SEEK_END:
+    res = VOP_STAT(of->of_vnode, &st);
+    if (res) {
+      lock_release(of->of_offsetlock);
+      return res;
+    }
+    newpos = st.st_size + pos;
+    break;
+  default:
+    lock_release(of->of_offsetlock);
+    return EINVAL;
+  }
+  if (newpos < 0) {
+    lock_release(of->of_offsetlock);
+    return EINVAL;
+  }
+  res = isdir ? 0 : VOP_TRYSEEK(of->of_vnode, newpos);
+  if (res == 0) {
+    of->of_offset = newpos;
+  }
+  lock_release(of->of_offsetlock);
+  if (res) {
+    return res;
+  }
+  *retval = newpos;
+  return 0;
+}
+
+int
+sys_getdirentry(int fdesc, userptr_t ubuf, size_t buflen, int *retval)
+{
+  struct openfile *of;
+  struct iovec iov;
+  struct uio u;
+  int res;
+
+  res = file_get(fdesc, &of);
+  if (res) {
+    return res;
+  }
+  if (of->of_accmode == O_WRONLY) {
+    return EBADF;
+  }
+
+  /* the offset is the filesystem's cookie for the next entry */
+  lock_acquire(of->of_offsetlock);
+  iov.iov_ubase = ubuf;
+  iov.iov_len = buflen;
+  u.uio_iov = &iov;
+  u.uio_iovcnt = 1;
+  u.uio_offset = of->of_offset;
+  u.uio_resid = buflen;
+  u.uio_segflg = UIO_USERSPACE;
+  u.uio_rw = UIO_READ;
+  u.uio_space = curproc->p_addrspace;
+  res = VOP_GETDIRENTRY(of->of_vnode, &u);
+  if (res == 0) {
+    of->of_offset = u.uio_offset;
+  }
+  lock_release(of->of_offsetlock);
+  if (res) {
+    return res;
+  }
+
+  *retval = buflen - u.uio_resid;
+  return 0;
+}
+
+int
+sys_close(int fdesc)
+{
+  struct openfile *of;
+  int res;
+
+  KASSERT(curproc->p_filetable != NULL);
+  res = filetable_remove(curproc->p_filetable, fdesc, &of);
+  if (res) {
+    return res;
+  }
+  openfile_decref(of);
+  return 0;
+}
+
+int
+sys_dup2(int oldfd, int newfd, int *retval)
+{
+  struct openfile *of, *old;
+  int res;
+
+  res = file_get(oldfd, &of);
+  if (res) {
+    return res;
+  }
+  if (newfd < 0 || newfd >= OPEN_MAX) {
+    return EBADF;
+  }
+  if (oldfd != newfd) {
+    openfile_incref(of);
+    filetable_placeat(curproc->p_filetable, of, newfd, &old);
+    if (old != NULL) {
+      openfile_decref(old);
+    }
+  }
+  *retval = newfd;
+  return 0;
+}
+
+int
+sys_fstat(int fdesc, userptr_t ustat)
+{
+  struct openfile *of;
+  struct stat st;
+  int res;
+
+  res = file_get(fdesc, &of);
+  if (res) {
+    return res;
+  }
+  res = VOP_STAT(of->of_vnode, &st);
+  if (res) {
+    return res;
+  }
+  return copyout(&st, ustat, sizeof(st));
+}
+
+int
+sys_stat(userptr_t upath, userptr_t ustat)
+{
+  struct vnode *vn;
+  struct stat st;
+  char *path;
+  int res;
+
+  res = file_copyinpath(upath, &path);
+  if (res) {
+    return res;
+  }
+  res = vfs_lookup(path, &vn);
+  kfree(path);
+  if (res) {
+    return res;
+  }
+  res = VOP_STAT(vn, &st);
+  VOP_DECREF(vn);
+  if (res) {
+    return res;
+  }
+  return copyout(&st, ustat, sizeof(st));
+}
+
+/*
+ * Pathname calls that map straight onto the VFS layer.
+ */
+
+int
+sys_remove(userptr_t upath)
+{
+  char *path;
+  int res;
+
+  res = file_copyinpath(upath, &path);
+  if (res) {
+    return res;
+  }
+  res = vfs_remove(path);
+  kfree(path);
+  return res;
+}
+
+int
+sys_mkdir(userptr_t upath, mode_t mode)
+{
+  char *path;
+  int res;
+
+  res = file_copyinpath(upath, &path);
+  if (res) {
+    return res;
+  }
+  res = vfs_mkdir(path, mode);
+  kfree(path);
+  return res;
+}
+
+int
+sys_chdir(userptr_t upath)
+{
+  char *path;
+  int res;
+
+  res = file_copyinpath(upath, &path);
+  if (res) {
+    return res;
+  }
+  res = vfs_chdir(path);
+  kfree(path);
+  return res;
+}
+
+/* size of the kernel buffer fdcopy moves data through */
+#define FDCOPY_BUFSIZE (16 * 1024)
+
+/*
+ * Copy up to len bytes from infd to outfd, at (and advancing) each
+ * file's offset, through a kernel buffer, so the data never goes out
+ * to userlevel and back. Stops early at end of file or after any short
+ * read, so copying from a pipe or the console returns what is
+ * available rather than waiting for all len bytes. Each chunk is read
+ * and written with the usual read and write locking, so concurrent
+ * users of either file may see the copy interleaved with their own
+ * I/O at chunk boundaries.
+ *
+ * If a write fails partway through a chunk, the input offset is moved
+ * back over the bytes that were read but not written, so the caller
+ * can pick up where the copy stopped. Input that can't seek has lost
+ * them, so then the error is returned even if some data got through.
+ */
+int
+sys_fdcopy(int infd, int outfd, size_t len, int *retval)
+{
+  struct openfile *of, *inof;
+  struct iovec iov;
+  char *buf;
+  size_t done, chunk, wdone;
+  int nread, nwritten, res;
+
+  DEBUG(DB_SYSCALL,"Syscall: fdcopy(%d,%d,%u)\n",infd,outfd,len);
+
+  /* fail up front on bad descriptors, before reading anything */
+  res = file_get(infd, &inof);
+  if (res) {
+    return res;
+  }
+  if (inof->of_accmode == O_WRONLY) {
+    return EBADF;
+  }
+  res = file_get(outfd, &of);
+  if (res) {
+    return res;
+  }
+  if (of->of_accmode == O_RDONLY) {
+    return EBADF;
+  }
+  if (len > IOV_TOTAL_MAX) {
+    len = IOV_TOTAL_MAX;
+  }
+
+  buf = kmalloc(FDCOPY_BUFSIZE);
+  if (buf == NULL) {
+    return ENOMEM;
+  }
+
+  done = 0;
+  while (done < len) {
+    chunk = len - done;
+    if (chunk > FDCOPY_BUFSIZE) {
+      chunk = FDCOPY_BUFSIZE;
+    }
+    iov.iov_kbase = buf;
+    iov.iov_len = chunk;
+    res = file_io(infd, &iov, 1, chunk, NULL, UIO_READ, UIO_SYSSPACE,
+                  &nread);
+    if (res || nread == 0) {
+      break;
+    }
+
+    /* the output side may take it in pieces (pipes do) */
+    for (wdone = 0; wdone < (size_t)nread; wdone += nwritten) {
+      iov.iov_kbase = buf + wdone;
+      iov.iov_len = nread - wdone;
+      res = file_io(outfd, &iov, 1, nread - wdone, NULL, UIO_WRITE,
+                    UIO_SYSSPACE, &nwritten);
+      if (res == 0 && nwritten == 0) {
+        res = EIO;
+      }
+      if (res) {
+        break;
+      }
+      done += nwritten;
+    }
+    if (res) {
+      if (!inof->of_seekable) {
+        kfree(buf);
+        return res;
+      }
+      lock_acquire(inof->of_offsetlock);
+      inof->of_offset -= nread - wdone;
+      lock_release(inof->of_offsetlock);
+      break;
+    }
+    if ((size_t)nread < chunk) {
+      break;
+    }
+  }
+  kfree(buf);
+
+  /* report a failure only if nothing got through */
+  if (res && done == 0) {
+    return res;
+  }
+  *retval = done;
+  return 0;
+}
+
+/*
+ * Fill in revents for every entry of fds and return how many are
+ * nonzero. Unless pw is NULL, objects that aren't ready add pw to
+ * their poll queues, until something turns out to be ready.
+ */
+static int
+poll_scan(struct pollfd *fds, unsigned nfds, struct pollwaiter *pw,
+          int *nready)
+{
+  struct openfile *of;
+  unsigned i;
+  int revents, res;
+
+  *nready = 0;
+  for (i = 0; i < nfds; i++) {
+    fds[i].revents = 0;
+    if (fds[i].fd < 0) {
+      continue;
+    }
+    if (file_get(fds[i].fd, &of)) {
+      fds[i].revents = POLLNVAL;
+      (*nready)++;
+      continue;
+    }
+    res = VOP_POLL(of->of_vnode, fds[i].events, &revents,
+                   *nready == 0 ? pw : NULL);
+    if (res) {
+      return res;
+    }
+    fds[i].revents = revents & (fds[i].events|POLLERR|POLLHUP);
+    if (fds[i].revents != 0) {
+      (*nready)++;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Wait until one of the descriptors is ready, or timeout milliseconds
+ * pass (forever if negative). Timeouts are only as fine as the timer
+ * tick.
+ */
+int
+sys_poll(userptr_t ufds, unsigned nfds, int timeout, int *retval)
+{
+  struct pollfd *fds = NULL;
+  struct pollwaiter pw;
+  time_t endsecs, nowsecs;
+  uint32_t endnsecs, nownsecs;
+  int nready, res;
+
+  if (nfds > OPEN_MAX) {
+    return EINVAL;
+  }
+  if (nfds > 0) {
+    fds = kmalloc(nfds * sizeof(struct pollfd));
+    if (fds == NULL) {
+      return ENOMEM;
+    }
+    res = copyin(ufds, fds, nfds * sizeof(struct pollfd));
+    if (res) {
+      kfree(fds);
+      return res;
+    }
+  }
+  res = pollwaiter_init(&pw);
+  if (res) {
+    if (fds != NULL) {
+      kfree(fds);
+    }
+    return res;
+  }
+
+  if (timeout > 0) {
+    gettime(&endsecs, &endnsecs);
+    endsecs += timeout / 1000;
+    endnsecs += (timeout % 1000) * 1000000;
+    if (endnsecs >= 1000000000) {
+      endnsecs -= 1000000000;
+      endsecs++;
+    }
+  }
+
+  while (1) {
+    res = poll_scan(fds, nfds, timeout != 0 ? &pw : NULL, &nready);
+    if (res || nready > 0 || timeout == 0) {
+      break;
+    }
+    if (timeout > 0) {
+      gettime(&nowsecs, &nownsecs);
+      if (nowsecs > endsecs ||
+          (nowsecs == endsecs && nownsecs >= endnsecs)) {
+        break;
+      }
+    }
+    res = pollwaiter_wait(&pw, timeout > 0);
+    if (res) {
+      break;
+    }
+  }
+  /* the last scan may have left us on some queues */
+  pollwaiter_clear(&pw);
+  pollwaiter_cleanup(&pw);
+
+  if (res == 0 && nfds > 0) {
+    res = copyout(fds, ufds, nfds * sizeof(struct pollfd));
+  }
+  if (fds != NULL) {
+    kfree(fds);
+  }
+  if (res) {
+    return res;
+  }
+  *retval = nready;
+  return 0;
+}
+
+int
+sys_pipe(userptr_t ufds)
+{
+  struct vnode *rvn, *wvn;
+  struct openfile *rof, *wof, *junk;
+  int fds[2];
+  int res;
+
+  res = pipe_create(&rvn, &wvn);
+  if (res) {
+    return res;
+  }
+  res = openfile_create(rvn, O_RDONLY, &rof);
+  if (res) {
+    vfs_close(rvn);
+    vfs_close(wvn);
+    return res;
+  }
+  res = openfile_create(wvn, O_WRONLY, &wof);
+  if (res) {
+    openfile_decref(rof);
+    vfs_close(wvn);
+    return res;
+  }
+
+  res = filetable_place(curproc->p_filetable, rof, &fds[0]);
+  if (res) {
+    openfile_decref(rof);
+    openfile_decref(wof);
+    return res;
+  }
+  res = filetable_place(curproc->p_filetable, wof, &fds[1]);
+  if (res) {
+    filetable_remove(curproc->p_filetable, fds[0], &junk);
+    openfile_decref(rof);
+    openfile_decref(wof);
+    return res;
+  }
+
+  res = copyout(fds, ufds, sizeof(fds));
+  if (res) {
+    filetable_remove(curproc->p_filetable, fds[0], &junk);
+    filetable_remove(curproc->p_filetable, fds[1], &junk);
+    openfile_decref(rof);
+    openfile_decref(wof);
+    return res;
+  }
+  return 0;
+}
+#else
 /* handler for write() system call                  */
 /*
  * n.b.
@@ -58,3 +780,4 @@ sys_write(int fdesc,userptr_t ubuf,unsigned int nbytes,int *retval)
   KASSERT(*retval >= 0);
   return 0;
 }
+#endif
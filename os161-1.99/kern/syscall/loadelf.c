@@ -42,6 +42,10 @@
  * circumstances, as_prepare_load and as_complete_load probably don't
  * need to do anything.
  *
+ * Parsed headers and segment contents of recently run executables are
+ * kept in a small cache (see below), so running the same program
+ * again needs no file I/O beyond the vfs_open.
+ *
  * If you wanted to support memory-mapped executables you would need
  * to rearrange this to map each segment.
  *
@@ -59,6 +63,8 @@
 #include <addrspace.h>
 #include <vnode.h>
 #include <elf.h>
+#include <spinlock.h>
+#include <kstat.h>
 
 /*
  * Load a segment at virtual address VADDR. The segment in memory
@@ -146,27 +152,17 @@ load_segment(struct addrspace *as, struct vnode *v,
 }
 
 /*
- * Load an ELF executable user program into the current address space.
- *
- * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ * Read and check the executable header.
  */
+static
 int
-load_elf(struct vnode *v, vaddr_t *entrypoint)
+elf_readhdr(struct vnode *v, Elf_Ehdr *eh)
 {
-	Elf_Ehdr eh;   /* Executable header */
-	Elf_Phdr ph;   /* "Program header" = segment header */
-	int result, i;
 	struct iovec iov;
 	struct uio ku;
-	struct addrspace *as;
-
-	as = curproc_getas();
-
-	/*
-	 * Read the executable header from offset 0 in the file.
-	 */
+	int result;
 
-	uio_kinit(&iov, &ku, &eh, sizeof(eh), 0, UIO_READ);
+	uio_kinit(&iov, &ku, eh, sizeof(*eh), 0, UIO_READ);
 	result = VOP_READ(v, &ku);
 	if (result) {
 		return result;
@@ -189,19 +185,92 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 	 * which were not in the original elf spec.)
 	 */
 
-	if (eh.e_ident[EI_MAG0] != ELFMAG0 ||
-	    eh.e_ident[EI_MAG1] != ELFMAG1 ||
-	    eh.e_ident[EI_MAG2] != ELFMAG2 ||
-	    eh.e_ident[EI_MAG3] != ELFMAG3 ||
-	    eh.e_ident[EI_CLASS] != ELFCLASS32 ||
-	    eh.e_ident[EI_DATA] != ELFDATA2MSB ||
-	    eh.e_ident[EI_VERSION] != EV_CURRENT ||
-	    eh.e_version != EV_CURRENT ||
-	    eh.e_type!=ET_EXEC ||
-	    eh.e_machine!=EM_MACHINE) {
+	if (eh->e_ident[EI_MAG0] != ELFMAG0 ||
+	    eh->e_ident[EI_MAG1] != ELFMAG1 ||
+	    eh->e_ident[EI_MAG2] != ELFMAG2 ||
+	    eh->e_ident[EI_MAG3] != ELFMAG3 ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS32 ||
+	    eh->e_ident[EI_DATA] != ELFDATA2MSB ||
+	    eh->e_ident[EI_VERSION] != EV_CURRENT ||
+	    eh->e_version != EV_CURRENT ||
+	    eh->e_type!=ET_EXEC ||
+	    eh->e_machine!=EM_MACHINE) {
 		return ENOEXEC;
 	}
 
+	return 0;
+}
+
+/*
+ * Read program header I. Sets *ISLOAD to whether it describes a
+ * segment to load; the other types we know of are skipped.
+ *
+ * Note that the expression eh.e_phoff + i*eh.e_phentsize is
+ * mandated by the ELF standard - we use sizeof(ph) to load,
+ * because that's the structure we know, but the file on disk
+ * might have a larger structure, so we must use e_phentsize
+ * to find where the phdr starts.
+ */
+static
+int
+elf_readphdr(struct vnode *v, const Elf_Ehdr *eh, int i, Elf_Phdr *ph,
+	     bool *isload)
+{
+	struct iovec iov;
+	struct uio ku;
+	off_t offset;
+	int result;
+
+	offset = eh->e_phoff + i*eh->e_phentsize;
+	uio_kinit(&iov, &ku, ph, sizeof(*ph), offset, UIO_READ);
+
+	result = VOP_READ(v, &ku);
+	if (result) {
+		return result;
+	}
+
+	if (ku.uio_resid != 0) {
+		/* short read; problem with executable? */
+		kprintf("ELF: short read on phdr - file truncated?\n");
+		return ENOEXEC;
+	}
+
+	switch (ph->p_type) {
+	    case PT_NULL: /* skip */
+	    case PT_PHDR: /* skip */
+	    case PT_MIPS_REGINFO: /* skip */
+		*isload = false;
+		return 0;
+	    case PT_LOAD:
+		*isload = true;
+		return 0;
+	    default:
+		kprintf("loadelf: unknown segment type %d\n",
+			ph->p_type);
+		return ENOEXEC;
+	}
+}
+
+/*
+ * Load an ELF executable straight from the file, without the cache.
+ */
+static
+int
+load_elf_direct(struct vnode *v, vaddr_t *entrypoint)
+{
+	Elf_Ehdr eh;   /* Executable header */
+	Elf_Phdr ph;   /* "Program header" = segment header */
+	bool isload;
+	int result, i;
+	struct addrspace *as;
+
+	as = curproc_getas();
+
+	result = elf_readhdr(v, &eh);
+	if (result) {
+		return result;
+	}
+
 	/*
 	 * Go through the list of segments and set up the address space.
 	 *
@@ -209,38 +278,15 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 	 * data segment, and one data/bss segment, but there might
 	 * conceivably be more. You don't need to support such files
 	 * if it's unduly awkward to do so.
-	 *
-	 * Note that the expression eh.e_phoff + i*eh.e_phentsize is 
-	 * mandated by the ELF standard - we use sizeof(ph) to load,
-	 * because that's the structure we know, but the file on disk
-	 * might have a larger structure, so we must use e_phentsize
-	 * to find where the phdr starts.
 	 */
 
 	for (i=0; i<eh.e_phnum; i++) {
-		off_t offset = eh.e_phoff + i*eh.e_phentsize;
-		uio_kinit(&iov, &ku, &ph, sizeof(ph), offset, UIO_READ);
-
-		result = VOP_READ(v, &ku);
+		result = elf_readphdr(v, &eh, i, &ph, &isload);
 		if (result) {
 			return result;
 		}
-
-		if (ku.uio_resid != 0) {
-			/* short read; problem with executable? */
-			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
-		}
-
-		switch (ph.p_type) {
-		    case PT_NULL: /* skip */ continue;
-		    case PT_PHDR: /* skip */ continue;
-		    case PT_MIPS_REGINFO: /* skip */ continue;
-		    case PT_LOAD: break;
-		    default:
-			kprintf("loadelf: unknown segment type %d\n", 
-				ph.p_type);
-			return ENOEXEC;
+		if (!isload) {
+			continue;
 		}
 
 		result = as_define_region(as,
@@ -263,34 +309,401 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 	 */
 
 	for (i=0; i<eh.e_phnum; i++) {
-		off_t offset = eh.e_phoff + i*eh.e_phentsize;
-		uio_kinit(&iov, &ku, &ph, sizeof(ph), offset, UIO_READ);
+		result = elf_readphdr(v, &eh, i, &ph, &isload);
+		if (result) {
+			return result;
+		}
+		if (!isload) {
+			continue;
+		}
 
-		result = VOP_READ(v, &ku);
+		result = load_segment(as, v, ph.p_offset, ph.p_vaddr, 
+				      ph.p_memsz, ph.p_filesz,
+				      ph.p_flags & PF_X);
 		if (result) {
 			return result;
 		}
+	}
+
+	result = as_complete_load(as);
+	if (result) {
+		return result;
+	}
+
+	*entrypoint = eh.e_entry;
+
+	return 0;
+}
+
+/*
+ * Executable image cache.
+ *
+ * An elfimage holds the parsed loadable segments of an executable and
+ * a kernel copy of their file contents. Images are keyed by vnode, on
+ * which they hold a reference so the vnode cannot be recycled for some
+ * other file, and record the vnode's vn_gen as of when they were read;
+ * a write or truncate bumps vn_gen, and the stale image is dropped the
+ * next time it is looked up.
+ *
+ * Images are refcounted: the cache holds one reference and each load
+ * in progress another. The last reference frees the image, which is
+ * done outside execcache_lock because dropping the vnode may sleep.
+ * Programs that are too big or have too many segments are not cached.
+ */
+
+#define ELFIMAGE_MAXSEGS	4
+#define ELFIMAGE_MAXBYTES	(256*1024)
+#define EXECCACHE_SIZE		8
+
+struct elfseg {
+	vaddr_t es_vaddr;
+	size_t es_memsize;
+	size_t es_filesize;
+	uint32_t es_flags;		/* PF_R, PF_W, PF_X */
+	char *es_data;			/* es_filesize bytes */
+};
+
+struct elfimage {
+	struct vnode *ei_vnode;
+	unsigned ei_gen;		/* ei_vnode->vn_gen when read */
+	vaddr_t ei_entrypoint;
+	unsigned ei_nsegs;
+	struct elfseg ei_segs[ELFIMAGE_MAXSEGS];
+	unsigned ei_refcount;		/* protected by execcache_lock */
+	unsigned ei_lastuse;		/* for LRU replacement */
+};
+
+static struct spinlock execcache_lock = SPINLOCK_INITIALIZER;
+static struct elfimage *execcache[EXECCACHE_SIZE];
+static unsigned execcache_clock;
+
+static struct kstat ks_hits = KSTAT_COUNTER("exec.cache_hits");
+static struct kstat ks_misses = KSTAT_COUNTER("exec.cache_misses");
+static int64_t execcache_hitpct(void);
+static struct kstat ks_hitpct =
+	KSTAT_GAUGEFN("exec.cache_hit_pct", execcache_hitpct);
+
+static
+int64_t
+execcache_hitpct(void)
+{
+	unsigned hits, total;
+
+	hits = kstat_read(&ks_hits);
+	total = hits + kstat_read(&ks_misses);
+	/* scale down so hits*100 fits; avoids 64-bit division */
+	while (total > 0x1000000) {
+		hits >>= 1;
+		total >>= 1;
+	}
+	return total == 0 ? 0 : hits * 100 / total;
+}
+
+static
+void
+elfimage_destroy(struct elfimage *ei)
+{
+	unsigned i;
+
+	KASSERT(ei->ei_refcount == 0);
+	for (i=0; i<ei->ei_nsegs; i++) {
+		kfree(ei->ei_segs[i].es_data);
+	}
+	VOP_DECREF(ei->ei_vnode);
+	kfree(ei);
+}
+
+static
+void
+elfimage_release(struct elfimage *ei)
+{
+	bool last;
+
+	spinlock_acquire(&execcache_lock);
+	KASSERT(ei->ei_refcount > 0);
+	ei->ei_refcount--;
+	last = (ei->ei_refcount == 0);
+	spinlock_release(&execcache_lock);
+
+	if (last) {
+		elfimage_destroy(ei);
+	}
+}
+
+/*
+ * Find a current image of V and return it with a reference, or NULL.
+ */
+static
+struct elfimage *
+execcache_lookup(struct vnode *v)
+{
+	struct elfimage *ei = NULL, *stale = NULL;
+	unsigned i;
+
+	spinlock_acquire(&execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] == NULL || execcache[i]->ei_vnode != v) {
+			continue;
+		}
+		if (execcache[i]->ei_gen != v->vn_gen) {
+			/* written since; drop the cache's reference */
+			stale = execcache[i];
+			execcache[i] = NULL;
+			stale->ei_refcount--;
+			if (stale->ei_refcount > 0) {
+				stale = NULL;
+			}
+			break;
+		}
+		ei = execcache[i];
+		ei->ei_refcount++;
+		ei->ei_lastuse = ++execcache_clock;
+		break;
+	}
+	spinlock_release(&execcache_lock);
+
+	if (stale != NULL) {
+		elfimage_destroy(stale);
+	}
+	return ei;
+}
+
+/*
+ * Add EI to the cache, replacing the least recently used image that
+ * is not in use. If every slot is busy, or V was cached by someone
+ * else meanwhile, EI is simply not cached.
+ */
+static
+void
+execcache_insert(struct elfimage *ei)
+{
+	struct elfimage *victim = NULL;
+	unsigned i, slot = EXECCACHE_SIZE;
+
+	spinlock_acquire(&execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i] == NULL) {
+			if (slot == EXECCACHE_SIZE ||
+			    execcache[slot] != NULL) {
+				slot = i;
+			}
+			continue;
+		}
+		if (execcache[i]->ei_vnode == ei->ei_vnode) {
+			slot = EXECCACHE_SIZE;
+			break;
+		}
+		if (execcache[i]->ei_refcount == 1 &&
+		    (slot == EXECCACHE_SIZE ||
+		     (execcache[slot] != NULL &&
+		      execcache[i]->ei_lastuse <
+		      execcache[slot]->ei_lastuse))) {
+			slot = i;
+		}
+	}
+	if (slot < EXECCACHE_SIZE) {
+		victim = execcache[slot];
+		if (victim != NULL) {
+			victim->ei_refcount--;
+			KASSERT(victim->ei_refcount == 0);
+		}
+		ei->ei_refcount++;
+		ei->ei_lastuse = ++execcache_clock;
+		execcache[slot] = ei;
+	}
+	spinlock_release(&execcache_lock);
+
+	if (victim != NULL) {
+		elfimage_destroy(victim);
+	}
+}
+
+/*
+ * Drop the cache's reference to the image of V, or to every image if
+ * V is NULL, so the vnodes can be reclaimed. Images still being loaded
+ * are freed when the load finishes. Called before a file is removed
+ * and when a filesystem is unmounted, which would otherwise find its
+ * vnodes busy.
+ */
+void
+execcache_flush(struct vnode *v)
+{
+	struct elfimage *dead[EXECCACHE_SIZE];
+	struct elfimage *ei;
+	unsigned i, ndead = 0;
+
+	spinlock_acquire(&execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		ei = execcache[i];
+		if (ei == NULL || (v != NULL && ei->ei_vnode != v)) {
+			continue;
+		}
+		execcache[i] = NULL;
+		ei->ei_refcount--;
+		if (ei->ei_refcount == 0) {
+			dead[ndead++] = ei;
+		}
+	}
+	spinlock_release(&execcache_lock);
+
+	for (i=0; i<ndead; i++) {
+		elfimage_destroy(dead[i]);
+	}
+}
+
+void
+execcache_bootstrap(void)
+{
+	kstat_register(&ks_hitpct);
+}
+
+/*
+ * Read the headers and segment contents of V into a new image, with
+ * one reference for the caller. Returns EFBIG if the program is not
+ * worth caching.
+ */
+static
+int
+elfimage_read(struct vnode *v, struct elfimage **ret)
+{
+	struct elfimage *ei;
+	struct elfseg *es;
+	struct iovec iov;
+	struct uio ku;
+	Elf_Ehdr eh;
+	Elf_Phdr ph;
+	bool isload;
+	size_t total = 0;
+	int result, i;
+
+	ei = kmalloc(sizeof(*ei));
+	if (ei == NULL) {
+		return ENOMEM;
+	}
+	/* sample the generation before reading anything */
+	ei->ei_gen = v->vn_gen;
+	ei->ei_nsegs = 0;
+	ei->ei_refcount = 1;
+	ei->ei_lastuse = 0;
+
+	result = elf_readhdr(v, &eh);
+	if (result) {
+		goto fail;
+	}
+	ei->ei_entrypoint = eh.e_entry;
+
+	for (i=0; i<eh.e_phnum; i++) {
+		result = elf_readphdr(v, &eh, i, &ph, &isload);
+		if (result) {
+			goto fail;
+		}
+		if (!isload) {
+			continue;
+		}
+		if (ph.p_filesz > ph.p_memsz) {
+			kprintf("ELF: warning: segment filesize > "
+				"segment memsize\n");
+			ph.p_filesz = ph.p_memsz;
+		}
+		total += ph.p_filesz;
+		if (ei->ei_nsegs == ELFIMAGE_MAXSEGS ||
+		    total > ELFIMAGE_MAXBYTES) {
+			result = EFBIG;
+			goto fail;
+		}
 
+		es = &ei->ei_segs[ei->ei_nsegs];
+		es->es_vaddr = ph.p_vaddr;
+		es->es_memsize = ph.p_memsz;
+		es->es_filesize = ph.p_filesz;
+		es->es_flags = ph.p_flags;
+		es->es_data = kmalloc(ph.p_filesz > 0 ? ph.p_filesz : 1);
+		if (es->es_data == NULL) {
+			result = ENOMEM;
+			goto fail;
+		}
+		ei->ei_nsegs++;
+
+		uio_kinit(&iov, &ku, es->es_data, ph.p_filesz, ph.p_offset,
+			  UIO_READ);
+		result = VOP_READ(v, &ku);
+		if (result) {
+			goto fail;
+		}
 		if (ku.uio_resid != 0) {
 			/* short read; problem with executable? */
-			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
+			kprintf("ELF: short read on segment - "
+				"file truncated?\n");
+			result = ENOEXEC;
+			goto fail;
 		}
+	}
+
+	VOP_INCREF(v);
+	ei->ei_vnode = v;
+	*ret = ei;
+	return 0;
 
-		switch (ph.p_type) {
-		    case PT_NULL: /* skip */ continue;
-		    case PT_PHDR: /* skip */ continue;
-		    case PT_MIPS_REGINFO: /* skip */ continue;
-		    case PT_LOAD: break;
-		    default:
-			kprintf("loadelf: unknown segment type %d\n", 
-				ph.p_type);
-			return ENOEXEC;
+ fail:
+	for (i=0; i<(int)ei->ei_nsegs; i++) {
+		kfree(ei->ei_segs[i].es_data);
+	}
+	kfree(ei);
+	return result;
+}
+
+/*
+ * Load a cached image into the current address space.
+ */
+static
+int
+elfimage_load(struct elfimage *ei, vaddr_t *entrypoint)
+{
+	struct addrspace *as;
+	struct elfseg *es;
+	struct iovec iov;
+	struct uio u;
+	unsigned i;
+	int result;
+
+	as = curproc_getas();
+
+	for (i=0; i<ei->ei_nsegs; i++) {
+		es = &ei->ei_segs[i];
+		result = as_define_region(as, es->es_vaddr, es->es_memsize,
+					  es->es_flags & PF_R,
+					  es->es_flags & PF_W,
+					  es->es_flags & PF_X);
+		if (result) {
+			return result;
 		}
+	}
 
-		result = load_segment(as, v, ph.p_offset, ph.p_vaddr, 
-				      ph.p_memsz, ph.p_filesz,
-				      ph.p_flags & PF_X);
+	result = as_prepare_load(as);
+	if (result) {
+		return result;
+	}
+
+	/* As in load_segment, but from the kernel copy. */
+	for (i=0; i<ei->ei_nsegs; i++) {
+		es = &ei->ei_segs[i];
+
+		DEBUG(DB_EXEC, "ELF: Loading %lu cached bytes to 0x%lx\n",
+		      (unsigned long) es->es_filesize,
+		      (unsigned long) es->es_vaddr);
+
+		iov.iov_ubase = (userptr_t)es->es_vaddr;
+		iov.iov_len = es->es_memsize;
+		u.uio_iov = &iov;
+		u.uio_iovcnt = 1;
+		u.uio_resid = es->es_filesize;
+		u.uio_offset = 0;
+		u.uio_segflg = (es->es_flags & PF_X) ?
+			UIO_USERISPACE : UIO_USERSPACE;
+		u.uio_rw = UIO_READ;
+		u.uio_space = as;
+
+		result = uiomove(es->es_data, es->es_filesize, &u);
 		if (result) {
 			return result;
 		}
@@ -301,7 +714,38 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		return result;
 	}
 
-	*entrypoint = eh.e_entry;
-
+	*entrypoint = ei->ei_entrypoint;
 	return 0;
 }
+
+/*
+ * Load an ELF executable user program into the current address space.
+ *
+ * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ */
+int
+load_elf(struct vnode *v, vaddr_t *entrypoint)
+{
+	struct elfimage *ei;
+	int result;
+
+	ei = execcache_lookup(v);
+	if (ei != NULL) {
+		kstat_inc(&ks_hits);
+	}
+	else {
+		kstat_inc(&ks_misses);
+		result = elfimage_read(v, &ei);
+		if (result == EFBIG) {
+			return load_elf_direct(v, entrypoint);
+		}
+		if (result) {
+			return result;
+		}
+		execcache_insert(ei);
+	}
+
+	result = elfimage_load(ei, entrypoint);
+	elfimage_release(ei);
+	return result;
+}
@@ -31,28 +31,11 @@ void sys__exit(int exitcode) {
       an unused variable */
 #if OPT_A2
    KASSERT(lk_process_table);
-   KASSERT(process_table);
-   lock_acquire(lk_process_table);
-   // remove process status
-   for (unsigned i = 0; i < array_num(process_table); i++) {
-      struct process_status* ps = array_get(process_table, i);
-      KASSERT(ps);
-      // set self
-      if (ps->pid == curproc->pid) {
-         KASSERT(exitcode >= 0);
-         ps->exitcode = _MKWAIT_EXIT(exitcode);
-         ps->valid = false;
-         // wake parents
-         cv_broadcast(ps->cv_waitpid, lk_process_table);
-      }
-      // remove all children
-      else if (ps->parent == curproc->pid) {
-         process_status_destroy(ps);
-         array_remove(process_table, i);
-         i--;
-      }
-   }
-   lock_release(lk_process_table);
+   KASSERT(exitcode >= 0);
+   KASSERT(p->ps);
+   process_table_exit(p->ps, _MKWAIT_EXIT(exitcode));
+   // our parent may reap the status from here on
+   p->ps = NULL;
 #else
    (void)exitcode;
 #endif
@@ -69,7 +52,14 @@ void sys__exit(int exitcode) {
     * messily fatal.
     */
    as = curproc_setas(NULL);
+#if OPT_A2
+   // a vfork child hands the space back to its parent instead
+   if (! proc_vfork_release(p)) {
+      as_destroy(as);
+   }
+#else
    as_destroy(as);
+#endif
 
    /* detach this thread from its process */
    /* note: curproc cannot be used after this call */
@@ -93,28 +83,11 @@ void sys__kill(int exitcode) {
       an unused variable */
 #if OPT_A2
    KASSERT(lk_process_table);
-   KASSERT(process_table);
-   lock_acquire(lk_process_table);
-   // remove process status
-   for (unsigned i = 0; i < array_num(process_table); i++) {
-      struct process_status* ps = array_get(process_table, i);
-      KASSERT(ps);
-      // set self
-      if (ps->pid == curproc->pid) {
-         KASSERT(exitcode >= 0);
-         ps->exitcode = _MKWAIT_SIG(exitcode);
-         ps->valid = false;
-         // wake parents
-         cv_broadcast(ps->cv_waitpid, lk_process_table);
-      }
-      // remove all children
-      else if (ps->parent == curproc->pid) {
-         process_status_destroy(ps);
-         array_remove(process_table, i);
-         i--;
-      }
-   }
-   lock_release(lk_process_table);
+   KASSERT(exitcode >= 0);
+   KASSERT(p->ps);
+   process_table_exit(p->ps, _MKWAIT_SIG(exitcode));
+   // our parent may reap the status from here on
+   p->ps = NULL;
 #else
    (void)exitcode;
 #endif
@@ -131,7 +104,14 @@ void sys__kill(int exitcode) {
     * messily fatal.
     */
    as = curproc_setas(NULL);
+#if OPT_A2
+   // a vfork child hands the space back to its parent instead
+   if (! proc_vfork_release(p)) {
+      as_destroy(as);
+   }
+#else
    as_destroy(as);
+#endif
 
    /* detach this thread from its process */
    /* note: curproc cannot be used after this call */
@@ -176,42 +156,32 @@ sys_waitpid(pid_t pid,
    if (! status) {
       return EFAULT;
    }
-   if (options != 0) {
+   if ((options & ~WNOHANG) != 0) {
+      return EINVAL;
+   }
+   // process groups are not supported
+   if (pid < -1 || pid == 0) {
       return EINVAL;
    }
    KASSERT(lk_process_table);
-   KASSERT(process_table);
-   lock_acquire(lk_process_table);
-   struct process_status* st = get_process_status(pid);
-   // process exists
-   if (st) {
-      // if process is a child
-      KASSERT(st->parent);
-      KASSERT(curproc->pid);
-      if (st->parent == curproc->pid) {
-         // if process is running
-         if (st->valid) {
-            // kprintf("%d asleep\n", curproc->pid);
-            cv_wait(st->cv_waitpid, lk_process_table);
-            // kprintf("%d woke\n", curproc->pid);
-         }
-         err = copyout(&(st->exitcode), status, sizeof(int));
-         if (err) {
-            lock_release(lk_process_table);
-            return err;
-         }
-         *retval = st->pid;
-         lock_release(lk_process_table);
-         return 0;
-      }
-      // debug();
-      // if process isn't a child
-      lock_release(lk_process_table);
-      return ECHILD;
-   }
-   // process doesn't exist
-   lock_release(lk_process_table);
-   return ESRCH;
+   KASSERT(curproc->ps);
+   pid_t reaped;
+   int exitcode;
+   err = process_table_wait(curproc->ps, pid, options, &reaped, &exitcode);
+   if (err) {
+      return err;
+   }
+   // WNOHANG and no child has exited yet
+   if (reaped == 0) {
+      *retval = 0;
+      return 0;
+   }
+   err = copyout(&exitcode, status, sizeof(int));
+   if (err) {
+      return err;
+   }
+   *retval = reaped;
+   return 0;
 #else
    int exitstatus;
    int result;
@@ -246,7 +216,6 @@ sys_waitpid(pid_t pid,
 
 int sys_fork(struct trapframe* tf, pid_t* rv) {
    KASSERT(lk_process_table);
-   KASSERT(process_table);
    struct proc* proc = proc_create_runprogram(curproc->p_name);
    if (! proc) {
       return ENPROC;
@@ -256,158 +225,263 @@ int sys_fork(struct trapframe* tf, pid_t* rv) {
       return ENOMEM;
    }
    
-   lock_acquire(lk_process_table);
    struct trapframe* childtf = kmalloc(sizeof(struct trapframe));
    if (! childtf) {
       proc_destroy(proc);
       return ENOMEM;
    }
    *childtf = *tf;
+   // the child may run and exit before thread_fork returns
+   KASSERT(proc->pid >= PID_MIN);
+   pid_t pid = proc->pid;
    if (thread_fork("", proc, &enter_forked_process, childtf, 1)) {
       proc_destroy(proc);
       kfree(childtf);
       return EMPROC;
    };
-   KASSERT(proc->pid >= PID_MIN);
-   *rv = proc->pid;
-   lock_release(lk_process_table);
+   *rv = pid;
    
    return 0;
 }
 
-// copy args to kernel heap
-static int copy_args(userptr_t u_progname, userptr_t u_args, 
-                     unsigned* p_argc, char** p_progname, char*** p_args) {
-   
+/*
+ * vfork: like fork, but the child runs in our address space instead
+ * of a copy, and we sleep until it execs or exits. Only meant for
+ * spawn-then-exec; the child must not return from the function that
+ * called vfork.
+ */
+int sys_vfork(struct trapframe* tf, pid_t* rv) {
+   KASSERT(lk_process_table);
+   struct proc* parent = curproc;
+   if (! parent->p_vforksem) {
+      parent->p_vforksem = sem_create("vfork", 0);
+      if (! parent->p_vforksem) {
+         return ENOMEM;
+      }
+   }
+   struct proc* proc = proc_create_runprogram(parent->p_name);
+   if (! proc) {
+      return ENPROC;
+   }
+
+   struct trapframe* childtf = kmalloc(sizeof(struct trapframe));
+   if (! childtf) {
+      proc_destroy(proc);
+      return ENOMEM;
+   }
+   *childtf = *tf;
+   proc->p_addrspace = curproc_getas();
+   proc->p_vforkparent = parent;
+   KASSERT(proc->pid >= PID_MIN);
+   pid_t pid = proc->pid;
+   if (thread_fork("", proc, &enter_forked_process, childtf, 1)) {
+      proc->p_addrspace = NULL;
+      proc->p_vforkparent = NULL;
+      proc_destroy(proc);
+      kfree(childtf);
+      return EMPROC;
+   }
+   // the child may already be gone, so don't touch proc from here on
+   P(parent->p_vforksem);
+   *rv = pid;
+
+   return 0;
+}
+
+/*
+ * Copy in the program name and argv for exec. The name goes in its own
+ * PATH_MAX buffer; the arguments all go in one argbuf arena.
+ */
+static int copy_args(userptr_t u_progname, userptr_t u_args,
+                     char** p_progname, struct argbuf* ab) {
    int err;
-   
-   /* Parse u_args */
-   unsigned argc = 0;
-   char* progname;
-   char** args;
-      
-   // count args
-   while (((char**)u_args)[argc]) {
-      argc++;
+   char* progname = kmalloc(PATH_MAX);
+   if (! progname) {
+      return ENOMEM;
    }
-   
-   unsigned sl;
-   // copy program name
-   sl = strlen((char*)u_progname);
-   progname = kmalloc((sl + 1) * sizeof(char));
    err = copyinstr(u_progname, progname, PATH_MAX, NULL);
    if (err) {
+      kfree(progname);
       return err;
    }
-   // kprintf("sys_execv %s ", progname);
-   
-   // alloc string array
-   args = kmalloc(argc * sizeof(char*));
-   if ((! args) && (argc > 0)) {
-      return ENOMEM;
+   err = argbuf_init(ab);
+   if (err) {
+      kfree(progname);
+      return err;
    }
-   
-   // copy pointer to each str
-   for (unsigned i = 0; i < argc; i++) {
-      sl = strlen(((char**)u_args)[i]);
-      args[i] = kmalloc((sl + 1) * sizeof(char));
-      if ((! args[i]) && (sl > 0)) {
-         return ENOMEM;
-      }
-      
-      err = copyinstr((userptr_t)(((char**)u_args)[i]), args[i], ARG_MAX, NULL);
-      if (err) {
-         return err;
-      }
-      // kprintf("%s ", args[i]);
+   err = argbuf_copyin(ab, u_args);
+   if (err) {
+      argbuf_cleanup(ab);
+      kfree(progname);
+      return err;
    }
-   // kprintf("argc = %d\n", argc);
-   
-   *p_argc = argc;
    *p_progname = progname;
-   *p_args = args;
-   
    return 0;
 }
 
-static void free_args(unsigned argc, char* progname, char** args) {
+static void free_args(char* progname, struct argbuf* ab) {
    kfree(progname);
-   for (unsigned i = 0; i < argc; i++) {
-      kfree(args[i]);
-   } 
-   kfree(args);
+   argbuf_cleanup(ab);
 }
 
 int sys_execv(userptr_t u_progname, userptr_t u_args, int* retval) {
    int err;
    *retval = 0;
 
-   unsigned argc = 0;
    char* progname;
-   char** args;
-   
-   err = copy_args(u_progname, u_args, &argc, &progname, &args);
+   struct argbuf ab;
+
+   err = copy_args(u_progname, u_args, &progname, &ab);
    if (err) {
       return err;
    }
-   
-   // kprintf("\nsys_execv %s %d ", progname, argc);
-   // for (unsigned i = 0; i < argc; i++) {
-   //    kprintf("%s ", args[i]);  
-   // }
-   // kprintf("\n");
-   
+
    // create new addrspace
    struct addrspace* as = as_create();
    if (! as) {
+      free_args(progname, &ab);
       return ENOMEM;
    }
-   
+
    // open program
    struct vnode *v;
    err = vfs_open(progname, O_RDONLY, 0, &v);
    if (err) {
+      as_destroy(as);
+      free_args(progname, &ab);
       return err;
    }
-   
-   as_destroy(curproc_getas());
-   curproc_setas(as);
+
+   struct addrspace* oldas = curproc_setas(as);
+   // a vfork child hands the old space back to its parent instead
+   if (! proc_vfork_release(curproc)) {
+      as_destroy(oldas);
+   }
    as_activate();
-   
+
    // load program
    vaddr_t entrypoint;
    err = load_elf(v, &entrypoint);
    vfs_close(v);
    if (err) {
+      free_args(progname, &ab);
       return err;
    }
-   
+
    vaddr_t stackptr;
    err = as_define_stack(as, &stackptr);
    if (err) {
+      free_args(progname, &ab);
       return err;
    }
-   
-   // put args pointers in place
-   // put args strings in place
-   // stackptr ready
-   userptr_t arg_string_ptrs, arg_string;
-   err = assign_ustack_space(argc, args, &arg_string_ptrs, &arg_string, (userptr_t*)(&stackptr));
+
+   // lay out argv on the new stack
+   userptr_t uargv;
+   unsigned long argc = ab.ab_argc;
+   err = assign_ustack_space(&ab, &stackptr, &uargv);
+   free_args(progname, &ab);
    if (err) {
       return err;
    }
-   
-   // free args
-   free_args(argc, progname, args);
-   
+
    /* Warp to user mode. */
    enter_new_process(argc /*arg count*/,
-                     arg_string_ptrs /*userspace addr of args*/,
+                     uargv /*userspace addr of args*/,
                      stackptr,
                      entrypoint);
-   
+
    // should not return
    return -1;
 }
 
+/* Where a spawned child starts out in user mode. */
+struct spawn_entry {
+   unsigned long argc;
+   userptr_t argv;
+   vaddr_t stackptr;
+   vaddr_t entrypoint;
+};
+
+static void enter_spawned_process(void* data, unsigned long unused) {
+   struct spawn_entry se = *(struct spawn_entry*)data;
+   kfree(data);
+   (void)unused;
+   enter_new_process(se.argc, se.argv, se.stackptr, se.entrypoint);
+}
+
+/*
+ * spawn: fork and exec in one go. The child's image is loaded here by
+ * the parent's thread, running in the child's new address space just
+ * for the load, so nothing of the parent's is copied and a load error
+ * comes back to the caller instead of killing a half-built child.
+ */
+int sys_spawn(userptr_t u_progname, userptr_t u_args, pid_t* retval) {
+   int err;
+   char* progname;
+   struct argbuf ab;
+
+   KASSERT(lk_process_table);
+   err = copy_args(u_progname, u_args, &progname, &ab);
+   if (err) {
+      return err;
+   }
+
+   struct vnode *v;
+   err = vfs_open(progname, O_RDONLY, 0, &v);
+   if (err) {
+      free_args(progname, &ab);
+      return err;
+   }
+
+   struct spawn_entry* se = kmalloc(sizeof(struct spawn_entry));
+   struct addrspace* as = as_create();
+   struct proc* proc = proc_create_runprogram(progname);
+   if (! se || ! as || ! proc) {
+      err = proc ? ENOMEM : ENPROC;
+      goto fail;
+   }
+
+   // borrow the child's address space to load it
+   struct addrspace* ouras = curproc_setas(as);
+   as_activate();
+   err = load_elf(v, &se->entrypoint);
+   if (! err) {
+      err = as_define_stack(as, &se->stackptr);
+   }
+   if (! err) {
+      err = assign_ustack_space(&ab, &se->stackptr, &se->argv);
+   }
+   curproc_setas(ouras);
+   as_activate();
+   if (err) {
+      goto fail;
+   }
+   se->argc = ab.ab_argc;
+   proc->p_addrspace = as;
+
+   KASSERT(proc->pid >= PID_MIN);
+   pid_t pid = proc->pid;
+   err = thread_fork(progname, proc, &enter_spawned_process, se, 0);
+   if (err) {
+      proc->p_addrspace = NULL;
+      goto fail;
+   }
+   vfs_close(v);
+   free_args(progname, &ab);
+   *retval = pid;
+   return 0;
+
+ fail:
+   if (proc) {
+      proc_destroy(proc);
+   }
+   if (as) {
+      as_destroy(as);
+   }
+   kfree(se);
+   vfs_close(v);
+   free_args(progname, &ab);
+   return err;
+}
+
 #endif
@@ -47,77 +47,142 @@
 #include <copyinout.h>
 #include <limits.h>
 
-int assign_ustack_space(unsigned long argc,
-                        char** argv,
-                        userptr_t* p_arg_string_ptrs,
-                        userptr_t* p_arg_strings,
-                        userptr_t* p_stack_top) {
-	char** arg_string_ptrs = (char**)(*p_arg_string_ptrs);
-	char* arg_strings = (char*)(*p_arg_strings);
-	char* stack_top = (char*)(*p_stack_top);
-	
-	// kprintf("Received argc = %lu, args = ", argc);
-	// for (unsigned i = 0; i < argc; i++) {
-	// 	kprintf("%s ", argv[i]);
-	// }
-	// kprintf("\n");
-	
-	/* find top of stack by counting backwards */
-	// yield string space
-	for (unsigned long i = 1; i <= argc; i++) {
-		size_t space = strlen(argv[argc - i]) + 1; // include null
-		// kprintf("stack_top %p -= space %d -> ", stack_top, space);
-		stack_top -= space * 4;
-		// kprintf("%p\n", stack_top);
+/*
+ * Exec arguments are gathered into one arena of ARGBUF_MAX bytes: the
+ * strings packed back to back, with room kept at the end for the argv
+ * pointer array, which counts against the limit too. The arena is then
+ * laid out on the new user stack with one copyout for the strings and
+ * one for the pointers.
+ *
+ * The limit is ARG_MAX, or less if the new stack is smaller: the
+ * arguments must fit on it with a page to spare for the program
+ * itself. This has to be caught while copying them in, since by the
+ * time they are laid out execv has thrown away the old image and has
+ * nowhere to return an error to.
+ */
+#define ARGBUF_STACKMAX ((DUMBVM_STACKPAGES - 1) * PAGE_SIZE)
+#define ARGBUF_MAX (ARG_MAX < ARGBUF_STACKMAX ? ARG_MAX : ARGBUF_STACKMAX)
+
+int
+argbuf_init(struct argbuf *ab)
+{
+	/* slack for aligning the pointer array behind the strings */
+	ab->ab_buf = kmalloc(ARGBUF_MAX + sizeof(userptr_t));
+	if (ab->ab_buf == NULL) {
+		return ENOMEM;
 	}
-	// yield null
-	*stack_top = 0;
-	stack_top -= 4; 
-	
-	// yield ptr space
-	// kprintf("stack_top %p -= argc %lu -> ", stack_top, argc);
-	stack_top -= argc * 4; 
-	// kprintf("%p\n", stack_top);
-	
-	
-	// grow forwards
-	arg_string_ptrs = (char**)(stack_top + 4);
-	arg_strings = (char*)(stack_top + 4 + argc * 4);
-	// yield null
-	arg_strings += 4;
-	
-	// kprintf("arg_string_ptrs %p\n", arg_string_ptrs);
-	// kprintf("arg_strings %p\n", arg_strings);
-	
-	KASSERT(stack_top);
-	KASSERT(arg_strings);
-	KASSERT(arg_string_ptrs);
-	
-	char* stack_bottom = arg_strings;
-	// kprintf("stack_bottom %p\n", stack_bottom);
-  	for (unsigned i = 0; i < argc; i++) {
-		// copy pointers
-		arg_string_ptrs[i] = stack_bottom;
-		// copy strings
-		size_t sizegot = 0;
-		// kprintf("argv[%d] = %s, sizegot %d\n", i, argv[i], sizegot);
-		int error = copyoutstr(argv[i], (userptr_t)stack_bottom, ARG_MAX, &sizegot);
-		if (error) {
-			return error;
-		};
-		// kprintf("stack_bottom %p += sizegot %d + 4 -> ", stack_bottom, sizegot);
-		stack_bottom += 4 * sizegot; // null char
-		// kprintf("%p\n", stack_bottom);
-  	}
-  	
-  	KASSERT((userptr_t)(stack_bottom - 4) == *p_stack_top);
-  	
-	*p_arg_string_ptrs = (userptr_t)arg_string_ptrs;
-	*p_arg_strings = (userptr_t)arg_strings;
-	*p_stack_top = (userptr_t)stack_top; 
-	
-	// kprintf("Returning %p\n", stack_top);
-	
+	ab->ab_len = 0;
+	ab->ab_argc = 0;
+	return 0;
+}
+
+void
+argbuf_cleanup(struct argbuf *ab)
+{
+	kfree(ab->ab_buf);
+	ab->ab_buf = NULL;
+}
+
+/*
+ * Space left for the next string, after reserving pointers for every
+ * string so far, the next one, and the terminating NULL.
+ */
+static
+size_t
+argbuf_room(struct argbuf *ab)
+{
+	size_t used;
+
+	used = ab->ab_len + (ab->ab_argc + 2) * sizeof(userptr_t);
+	return used < ARGBUF_MAX ? ARGBUF_MAX - used : 0;
+}
+
+int
+argbuf_add(struct argbuf *ab, const char *arg)
+{
+	size_t len;
+
+	len = strlen(arg) + 1;
+	if (len > argbuf_room(ab)) {
+		return E2BIG;
+	}
+	memcpy(ab->ab_buf + ab->ab_len, arg, len);
+	ab->ab_len += len;
+	ab->ab_argc++;
+	return 0;
+}
+
+int
+argbuf_copyin(struct argbuf *ab, userptr_t uargv)
+{
+	userptr_t uarg;
+	size_t room, got;
+	int result;
+
+	while (1) {
+		result = copyin((userptr_t)((vaddr_t)uargv +
+					    ab->ab_argc * sizeof(userptr_t)),
+				&uarg, sizeof(uarg));
+		if (result) {
+			return result;
+		}
+		if (uarg == NULL) {
+			return 0;
+		}
+		room = argbuf_room(ab);
+		if (room == 0) {
+			return E2BIG;
+		}
+		result = copyinstr(uarg, ab->ab_buf + ab->ab_len, room, &got);
+		if (result == ENAMETOOLONG) {
+			return E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		ab->ab_len += got;
+		ab->ab_argc++;
+	}
+}
+
+int
+assign_ustack_space(struct argbuf *ab, vaddr_t *stackptr, userptr_t *uargv)
+{
+	vaddr_t strings, argv, arg;
+	userptr_t *ptrs;
+	size_t ptrsize, off;
+	unsigned long i;
+	int result;
+
+	/* strings at the top of the stack, pointers below, 8-aligned */
+	ptrsize = (ab->ab_argc + 1) * sizeof(userptr_t);
+	strings = (*stackptr - ab->ab_len) & ~(vaddr_t)(sizeof(userptr_t)-1);
+	argv = (strings - ptrsize) & ~(vaddr_t)7;
+
+	/* build the pointer array in the arena, behind the strings */
+	off = ROUNDUP(ab->ab_len, sizeof(userptr_t));
+	KASSERT(off + ptrsize <= ARGBUF_MAX + sizeof(userptr_t));
+	ptrs = (userptr_t *)(ab->ab_buf + off);
+	arg = strings;
+	off = 0;
+	for (i=0; i<ab->ab_argc; i++) {
+		ptrs[i] = (userptr_t)arg;
+		arg += strlen(ab->ab_buf + off) + 1;
+		off = arg - strings;
+	}
+	ptrs[ab->ab_argc] = NULL;
+
+	result = copyout(ab->ab_buf, (userptr_t)strings, ab->ab_len);
+	if (result) {
+		return result;
+	}
+	result = copyout(ptrs, (userptr_t)argv, ptrsize);
+	if (result) {
+		return result;
+	}
+
+	*stackptr = argv;
+	*uargv = (userptr_t)argv;
 	return 0;
 }
 
@@ -173,20 +238,27 @@ runprogram(char *progname, unsigned long argc, char** argv)
 		return result;
 	}
 
-	// put argv pointers in place
-	// put argv strings in place
-	// stackptr ready
-	userptr_t arg_string_ptrs, arg_string;
-	int err = assign_ustack_space(argc, argv, &arg_string_ptrs, &arg_string, (userptr_t*)(&stackptr));
-	if (err) {
-		return err;
+	/* Copy the arguments onto the new stack. */
+	struct argbuf ab;
+	userptr_t uargv;
+	result = argbuf_init(&ab);
+	for (unsigned long i = 0; result == 0 && i < argc; i++) {
+		result = argbuf_add(&ab, argv[i]);
+	}
+	if (result == 0) {
+		result = assign_ustack_space(&ab, &stackptr, &uargv);
+	}
+	if (ab.ab_buf != NULL) {
+		argbuf_cleanup(&ab);
+	}
+	if (result) {
+		/* p_addrspace will go away when curproc is destroyed */
+		return result;
 	}
 
-	// kprintf("got %lu %s %p\n", argc, ((char**)arg_string_ptrs)[0], (char*)stackptr);
-	
 	/* Warp to user mode. */
 	enter_new_process(argc /*arg count*/,
-                     arg_string_ptrs /*userspace addr of argv*/,
+                     uargv /*userspace addr of argv*/,
                      stackptr,
                      entrypoint);
 
@@ -0,0 +1,352 @@
+/*
+ * Asynchronous I/O rings. See <kern/uring.h> for the interface.
+ *
+ * uring_enter copies each submission out of the shared page, takes a
+ * reference to its open file, and puts it on one global queue served
+ * by a fixed pool of kernel threads. A thread does the transfer
+ * straight to or from the process's memory through the kernel's
+ * direct map (as_kaddr), then posts the completion under ur_lock.
+ * Because the buffer is reached through the address space and not
+ * through curproc, the address space must outlive the request;
+ * as_destroy sees to that by calling uring_destroy, which waits until
+ * nothing is outstanding.
+ *
+ * Only seekable objects are accepted. A read from a pipe or the
+ * console can block forever, which would tie up a thread of the
+ * shared pool and hang its owner's exit.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/uring.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <kstat.h>
+#include <file.h>
+#include <syscall.h>
+#include <uring.h>
+#include "opt-A2.h"
+
+#if OPT_A2
+
+#define URING_NTHREADS	4
+
+/* the byte count comes back in an int */
+#define URING_LEN_MAX	0x7fffffffU
+
+struct uring {
+	struct addrspace *ur_as;
+	struct uring_ring *ur_ring;	/* kernel address of the shared page */
+	struct lock *ur_lock;
+	struct cv *ur_cv;		/* a completion was posted */
+	unsigned ur_sqhead;		/* our copies of the indexes we own */
+	unsigned ur_cqtail;
+	unsigned ur_inflight;		/* queued or running */
+};
+
+struct uring_req {
+	struct uring *rq_ring;
+	struct openfile *rq_file;	/* our own reference */
+	struct uring_sqe rq_sqe;	/* copied out of the ring */
+	struct uring_req *rq_next;
+};
+
+/* Requests waiting for a thread. */
+static struct lock *uring_qlock;
+static struct cv *uring_qcv;
+static struct uring_req *uring_qhead;
+static struct uring_req **uring_qtail = &uring_qhead;
+
+static struct kstat ks_submits = KSTAT_COUNTER("uring.submits");
+static struct kstat ks_enters = KSTAT_COUNTER("uring.enters");
+
+/*
+ * Completions posted but not yet reaped. The process owns ur_cqhead,
+ * so don't trust it past the ring size.
+ */
+static
+unsigned
+uring_unreaped(struct uring *ur)
+{
+	unsigned n;
+
+	n = ur->ur_cqtail - ur->ur_ring->ur_cqhead;
+	return n > URING_CQ_ENTRIES ? URING_CQ_ENTRIES : n;
+}
+
+static
+void
+uring_post(struct uring *ur, unsigned long userdata, int result)
+{
+	struct uring_cqe *cqe;
+
+	KASSERT(lock_do_i_hold(ur->ur_lock));
+
+	cqe = &ur->ur_ring->ur_cq[ur->ur_cqtail % URING_CQ_ENTRIES];
+	cqe->cqe_userdata = userdata;
+	cqe->cqe_result = result;
+	ur->ur_cqtail++;
+	ur->ur_ring->ur_cqtail = ur->ur_cqtail;
+	cv_broadcast(ur->ur_cv, ur->ur_lock);
+}
+
+/*
+ * Do the transfer for RQ. Runs on a pool thread.
+ */
+static
+int
+uring_do(struct uring_req *rq, int *count)
+{
+	struct uring_sqe *sqe = &rq->rq_sqe;
+	enum uio_rw rw;
+	struct iovec iov;
+	void *kbuf;
+	int result;
+
+	rw = (sqe->sqe_op == URING_OP_READ) ? UIO_READ : UIO_WRITE;
+
+	/* reading the file means writing the process's memory */
+	result = as_kaddr(rq->rq_ring->ur_as, sqe->sqe_buf, sqe->sqe_len,
+			  rw == UIO_READ, &kbuf);
+	if (result) {
+		return result;
+	}
+
+	iov.iov_kbase = kbuf;
+	iov.iov_len = sqe->sqe_len;
+	return openfile_io(rq->rq_file, &iov, 1, sqe->sqe_len,
+			   sqe->sqe_offset == URING_OFFSET_CUR ?
+			   NULL : &sqe->sqe_offset,
+			   rw, UIO_SYSSPACE, count);
+}
+
+static
+void
+uring_thread(void *unused1, unsigned long unused2)
+{
+	struct uring_req *rq;
+	struct uring *ur;
+	int result, count;
+
+	(void)unused1;
+	(void)unused2;
+
+	while (1) {
+		lock_acquire(uring_qlock);
+		while (uring_qhead == NULL) {
+			cv_wait(uring_qcv, uring_qlock);
+		}
+		rq = uring_qhead;
+		uring_qhead = rq->rq_next;
+		if (uring_qhead == NULL) {
+			uring_qtail = &uring_qhead;
+		}
+		lock_release(uring_qlock);
+
+		result = uring_do(rq, &count);
+
+		/* once ur_inflight drops, ur may be destroyed */
+		ur = rq->rq_ring;
+		lock_acquire(ur->ur_lock);
+		uring_post(ur, rq->rq_sqe.sqe_userdata,
+			   result ? -result : count);
+		KASSERT(ur->ur_inflight > 0);
+		ur->ur_inflight--;
+		lock_release(ur->ur_lock);
+
+		openfile_decref(rq->rq_file);
+		kfree(rq);
+	}
+}
+
+void
+uring_bootstrap(void)
+{
+	unsigned i;
+	int result;
+
+	uring_qlock = lock_create("uring");
+	uring_qcv = cv_create("uring");
+	if (uring_qlock == NULL || uring_qcv == NULL) {
+		panic("uring_bootstrap: Out of memory\n");
+	}
+	for (i=0; i<URING_NTHREADS; i++) {
+		result = thread_fork("uring", NULL, uring_thread, NULL, 0);
+		if (result) {
+			panic("uring_bootstrap: thread_fork: %s\n",
+			      strerror(result));
+		}
+	}
+}
+
+/*
+ * Start the request in SQE, or fail it. NOPs complete right away.
+ */
+static
+int
+uring_start(struct uring *ur, const struct uring_sqe *sqe)
+{
+	struct openfile *of;
+	struct uring_req *rq;
+	int result;
+
+	KASSERT(lock_do_i_hold(ur->ur_lock));
+
+	if (sqe->sqe_op == URING_OP_NOP) {
+		uring_post(ur, sqe->sqe_userdata, 0);
+		return 0;
+	}
+	if (sqe->sqe_op != URING_OP_READ && sqe->sqe_op != URING_OP_WRITE) {
+		return EINVAL;
+	}
+	if (sqe->sqe_len > URING_LEN_MAX) {
+		return EINVAL;
+	}
+	if (sqe->sqe_offset < 0 && sqe->sqe_offset != URING_OFFSET_CUR) {
+		return EINVAL;
+	}
+
+	result = filetable_get(curproc->p_filetable, sqe->sqe_fd, &of);
+	if (result) {
+		return result;
+	}
+	if (!of->of_seekable) {
+		return ESPIPE;
+	}
+
+	rq = kmalloc(sizeof(*rq));
+	if (rq == NULL) {
+		return ENOMEM;
+	}
+	openfile_incref(of);
+	rq->rq_ring = ur;
+	rq->rq_file = of;
+	rq->rq_sqe = *sqe;
+	rq->rq_next = NULL;
+	ur->ur_inflight++;
+
+	lock_acquire(uring_qlock);
+	*uring_qtail = rq;
+	uring_qtail = &rq->rq_next;
+	cv_signal(uring_qcv, uring_qlock);
+	lock_release(uring_qlock);
+
+	kstat_inc(&ks_submits);
+	return 0;
+}
+
+void
+uring_destroy(struct uring *ur)
+{
+	lock_acquire(ur->ur_lock);
+	while (ur->ur_inflight > 0) {
+		cv_wait(ur->ur_cv, ur->ur_lock);
+	}
+	lock_release(ur->ur_lock);
+
+	cv_destroy(ur->ur_cv);
+	lock_destroy(ur->ur_lock);
+	kfree(ur);
+}
+
+int
+sys_uring_setup(userptr_t ringp)
+{
+	struct addrspace *as;
+	struct uring *ur;
+	vaddr_t uaddr;
+	void *kaddr;
+	int result;
+
+	as = curproc_getas();
+	KASSERT(as != NULL);
+	if (as->as_uring != NULL) {
+		return EBUSY;
+	}
+
+	result = as_define_ring(as, &uaddr, &kaddr);
+	if (result) {
+		return result;
+	}
+	result = copyout(&uaddr, ringp, sizeof(uaddr));
+	if (result) {
+		return result;
+	}
+
+	ur = kmalloc(sizeof(*ur));
+	if (ur == NULL) {
+		return ENOMEM;
+	}
+	ur->ur_lock = lock_create("uring");
+	if (ur->ur_lock == NULL) {
+		kfree(ur);
+		return ENOMEM;
+	}
+	ur->ur_cv = cv_create("uring");
+	if (ur->ur_cv == NULL) {
+		lock_destroy(ur->ur_lock);
+		kfree(ur);
+		return ENOMEM;
+	}
+	ur->ur_as = as;
+	ur->ur_ring = kaddr;
+	ur->ur_sqhead = 0;
+	ur->ur_cqtail = 0;
+	ur->ur_inflight = 0;
+
+	as->as_uring = ur;
+	return 0;
+}
+
+int
+sys_uring_enter(unsigned to_submit, unsigned min_complete, int *retval)
+{
+	struct uring *ur;
+	struct uring_sqe sqe;
+	unsigned submitted;
+	int result;
+
+	ur = curproc_getas()->as_uring;
+	if (ur == NULL) {
+		return EINVAL;
+	}
+	if (min_complete > URING_CQ_ENTRIES) {
+		return EINVAL;
+	}
+	kstat_inc(&ks_enters);
+
+	lock_acquire(ur->ur_lock);
+
+	/* stop while the completion ring could not take one more */
+	submitted = 0;
+	while (submitted < to_submit &&
+	       ur->ur_sqhead != ur->ur_ring->ur_sqtail &&
+	       ur->ur_inflight + uring_unreaped(ur) < URING_CQ_ENTRIES) {
+		sqe = ur->ur_ring->ur_sq[ur->ur_sqhead % URING_SQ_ENTRIES];
+		ur->ur_sqhead++;
+		ur->ur_ring->ur_sqhead = ur->ur_sqhead;
+		submitted++;
+
+		result = uring_start(ur, &sqe);
+		if (result) {
+			uring_post(ur, sqe.sqe_userdata, -result);
+		}
+	}
+
+	/* nothing in flight means nothing more is coming */
+	while (uring_unreaped(ur) < min_complete && ur->ur_inflight > 0) {
+		cv_wait(ur->ur_cv, ur->ur_lock);
+	}
+
+	lock_release(ur->ur_lock);
+
+	*retval = submitted;
+	return 0;
+}
+
+#endif /* OPT_A2 */
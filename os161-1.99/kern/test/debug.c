@@ -12,21 +12,28 @@
 #include <synch.h>
 #include "opt-A2.h"
 #include "debug.h"
+#include <limits.h>
 
 #if OPT_A2
 /* process related stuff */
 
 void debug() {
    KASSERT(lk_process_table);
-   KASSERT(process_table);
-   kprintf("newtable: %d", array_num(process_table));
-   for (unsigned i = 0; i < array_num(process_table); i++) {
-      struct process_status* a = array_get(process_table, i);
+   unsigned n = 0;
+   rwlock_acquire_read(lk_process_table);
+   kprintf("newtable: ");
+   for (pid_t i = PID_MIN; i < PID_MAX; i++) {
+      struct process_status* a = get_process_status(i);
+      if (! a) {
+         continue;
+      }
       struct process_status* p = get_process_status(a->parent);
       kprintf("(%d,%d) ", a->pid, a->parent);
       KASSERT(!p || a->parent == p->pid);
+      n++;
    }
-   kprintf("\n");
+   rwlock_release_read(lk_process_table);
+   kprintf("[%u]\n", n);
 }
 
 void debug_status(struct process_status* ps) {
@@ -36,6 +36,7 @@
 #include <clock.h>
 #include <thread.h>
 #include <synch.h>
+#include <spinlock.h>
 #include <test.h>
 
 #define NSEMLOOPS     63
@@ -347,3 +348,460 @@ cvtest(int nargs, char **args)
 
 	return 0;
 }
+
+////////////////////////////////////////////////////////////
+//
+// Reader-writer lock test.
+
+#define NRWLOOPS      200
+#define NRWWRITERS    4
+#define RWBENCHTIME   1	/* seconds per throughput run */
+
+static struct rwlock *testrw;
+static volatile bool rwstop;
+static volatile unsigned long rwreads[NTHREADS];
+
+/*
+ * Check that the three test values are consistent with each other.
+ * Writers update them non-atomically under the write lock, so a
+ * reader that sees them inconsistent got in alongside a writer.
+ */
+static
+bool
+rwcheck(void)
+{
+	unsigned long v1, v2, v3;
+
+	v1 = testval1;
+	v2 = testval2;
+	v3 = testval3;
+	return v2 == v1*v1 && v3 == v1%3;
+}
+
+static
+void
+rwreaderthread(void *junk, unsigned long num)
+{
+	int i;
+	(void)junk;
+
+	for (i=0; i<NRWLOOPS; i++) {
+		rwlock_acquire_read(testrw);
+		if (!rwcheck()) {
+			kprintf("thread %lu: Inconsistent values under "
+				"read lock\n", num);
+			kprintf("Test failed\n");
+		}
+		rwlock_release_read(testrw);
+	}
+	V(donesem);
+}
+
+static
+void
+rwwriterthread(void *junk, unsigned long num)
+{
+	int i;
+	(void)junk;
+
+	for (i=0; i<NRWLOOPS; i++) {
+		rwlock_acquire_write(testrw);
+		testval1 = num;
+		thread_yield();
+		testval2 = num*num;
+		thread_yield();
+		testval3 = num%3;
+		if (!rwcheck()) {
+			kprintf("thread %lu: Inconsistent values under "
+				"write lock\n", num);
+			kprintf("Test failed\n");
+		}
+		rwlock_release_write(testrw);
+	}
+	V(donesem);
+}
+
+/*
+ * Reader for the throughput runs: take and drop the lock shared as
+ * often as possible until told to stop.
+ */
+static
+void
+rwbenchthread(void *junk, unsigned long num)
+{
+	unsigned long count = 0;
+	(void)junk;
+
+	while (!rwstop) {
+		rwlock_acquire_read(testrw);
+		if (!rwcheck()) {
+			kprintf("thread %lu: Inconsistent values\n", num);
+		}
+		rwlock_release_read(testrw);
+		count++;
+	}
+	rwreads[num] = count;
+	V(donesem);
+}
+
+/*
+ * Run NREADERS bench threads for RWBENCHTIME seconds and report the
+ * total number of read acquisitions per second.
+ */
+static
+void
+rwbench(unsigned nreaders)
+{
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned long total;
+	unsigned i;
+	int result;
+
+	rwstop = false;
+	for (i=0; i<nreaders; i++) {
+		rwreads[i] = 0;
+		result = thread_fork("rwbench", NULL, rwbenchthread, NULL, i);
+		if (result) {
+			panic("rwtest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	gettime(&secs1, &nsecs1);
+	clocksleep(RWBENCHTIME);
+	rwstop = true;
+	for (i=0; i<nreaders; i++) {
+		P(donesem);
+	}
+	gettime(&secs2, &nsecs2);
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs2, &nsecs2);
+
+	total = 0;
+	for (i=0; i<nreaders; i++) {
+		total += rwreads[i];
+	}
+	kprintf("%2u readers: %lu reads in %lu.%09lu seconds, "
+		"%lu reads/sec\n", nreaders, total,
+		(unsigned long)secs2, (unsigned long)nsecs2,
+		(unsigned long)((uint64_t)total * 1000 /
+				(secs2 * 1000 + nsecs2 / 1000000)));
+}
+
+int
+rwtest(int nargs, char **args)
+{
+	int i, result;
+	unsigned n;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	testrw = rwlock_create("testrw");
+	if (testrw == NULL) {
+		panic("rwtest: rwlock_create failed\n");
+	}
+	testval1 = testval2 = testval3 = 0;
+
+	kprintf("Starting rwlock test...\n");
+	for (i=0; i<NTHREADS; i++) {
+		if (i < NRWWRITERS) {
+			result = thread_fork("rwtest", NULL, rwwriterthread,
+					     NULL, i);
+		}
+		else {
+			result = thread_fork("rwtest", NULL, rwreaderthread,
+					     NULL, i);
+		}
+		if (result) {
+			panic("rwtest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NTHREADS; i++) {
+		P(donesem);
+	}
+
+	/*
+	 * Reader throughput. With more CPUs than readers this should
+	 * grow with the number of readers; rerun with different cpu
+	 * counts in sys161.conf to see how it scales.
+	 */
+	kprintf("Measuring rwlock reader throughput...\n");
+	for (n=1; n<=NTHREADS; n*=2) {
+		rwbench(n);
+	}
+
+	rwlock_destroy(testrw);
+	testrw = NULL;
+#ifdef UW
+	cleanitems();
+#endif
+	kprintf("RW lock test done.\n");
+
+	return 0;
+}
+
+/*
+ * Spinlock benchmark. Compare plain and queued spinlocks by having N
+ * threads take and drop one spinlock as fast as they can. Run it with
+ * the cpus setting in sys161.conf at 2, 4, 8, and 32 to see how each
+ * kind behaves as contention goes up.
+ */
+
+#define SPINBENCHTIME 1	/* seconds per run */
+
+static struct spinlock testspin;
+static volatile bool spinstop;
+static volatile unsigned long spincounts[NTHREADS];
+
+static
+void
+spinbenchthread(void *junk, unsigned long num)
+{
+	unsigned long count = 0;
+	(void)junk;
+
+	while (!spinstop) {
+		spinlock_acquire(&testspin);
+		testval1 = num;
+		testval2 = num * num;
+		if (testval1 != num || testval2 != num * num) {
+			kprintf("thread %lu: Mutual exclusion failed\n", num);
+		}
+		spinlock_release(&testspin);
+		count++;
+	}
+	spincounts[num] = count;
+	V(donesem);
+}
+
+/*
+ * Run NTHR threads on TESTSPIN for SPINBENCHTIME seconds. Report the
+ * mean time per acquisition (including the hold time) as seen by one
+ * thread, and the spread between the luckiest and unluckiest thread
+ * as a measure of fairness.
+ */
+static
+void
+spinbench(const char *kind, unsigned nthr)
+{
+	time_t secs1, secs2;
+	uint32_t nsecs1, nsecs2;
+	unsigned long total, min, max;
+	uint64_t ns;
+	unsigned i;
+	int result;
+
+	spinstop = false;
+	for (i=0; i<nthr; i++) {
+		spincounts[i] = 0;
+		result = thread_fork("spinbench", NULL, spinbenchthread,
+				     NULL, i);
+		if (result) {
+			panic("spinlocktest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	gettime(&secs1, &nsecs1);
+	clocksleep(SPINBENCHTIME);
+	spinstop = true;
+	for (i=0; i<nthr; i++) {
+		P(donesem);
+	}
+	gettime(&secs2, &nsecs2);
+	getinterval(secs1, nsecs1, secs2, nsecs2, &secs2, &nsecs2);
+
+	total = 0;
+	min = max = spincounts[0];
+	for (i=0; i<nthr; i++) {
+		total += spincounts[i];
+		if (spincounts[i] < min) {
+			min = spincounts[i];
+		}
+		if (spincounts[i] > max) {
+			max = spincounts[i];
+		}
+	}
+	ns = (uint64_t)secs2 * 1000000000 + nsecs2;
+	kprintf("%-6s %2u threads: %8lu acquires, %8llu ns/acquire, "
+		"per-thread min %lu max %lu\n", kind, nthr, total,
+		total > 0 ? ns * nthr / total : 0ULL, min, max);
+}
+
+int
+spinlocktest(int nargs, char **args)
+{
+	static const unsigned nthrs[] = { 2, 4, 8, 32 };
+	unsigned i;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	kprintf("Starting spinlock benchmark...\n");
+	for (i=0; i<sizeof(nthrs)/sizeof(nthrs[0]); i++) {
+		spinlock_init(&testspin);
+		spinbench("plain", nthrs[i]);
+		spinlock_cleanup(&testspin);
+
+		spinlock_init_queued(&testspin);
+		spinbench("queued", nthrs[i]);
+		spinlock_cleanup(&testspin);
+	}
+#ifdef UW
+	cleanitems();
+#endif
+	kprintf("Spinlock benchmark done.\n");
+
+	return 0;
+}
+
+/*
+ * Priority inheritance test. A low-priority thread takes a lock, and
+ * a crowd of medium-priority threads then keeps every cpu busy. A
+ * high-priority thread then wants the lock. Without inheritance the
+ * low-priority holder never gets to run until the medium threads are
+ * done, so the high-priority thread waits for the whole run; with it,
+ * the holder is boosted, finishes, and the wait is short.
+ */
+
+#define PITESTTIME	3	/* seconds the medium threads run */
+#define PIHOLDMS	20	/* ms the low thread works holding the lock */
+#define NPIMEDIUM	NTHREADS
+
+static struct lock *pilock;
+static struct semaphore *piheld;
+static volatile bool pistop;
+static volatile uint64_t piwaitns;
+
+static
+uint64_t
+pinow(void)
+{
+	time_t secs;
+	uint32_t nsecs;
+
+	gettime(&secs, &nsecs);
+	return (uint64_t)secs * 1000000000 + nsecs;
+}
+
+static
+void
+pilowthread(void *junk, unsigned long num)
+{
+	uint64_t start;
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(THREAD_PRI_MIN);
+	lock_acquire(pilock);
+	V(piheld);
+	start = pinow();
+	while (pinow() - start < PIHOLDMS * 1000000ULL) {
+		/* busy: need the cpu to get done */
+	}
+	lock_release(pilock);
+	V(donesem);
+}
+
+static
+void
+pimediumthread(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	while (!pistop) {
+		/* keep the cpu busy */
+	}
+	V(donesem);
+}
+
+static
+void
+pihighthread(void *junk, unsigned long num)
+{
+	uint64_t start;
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(THREAD_PRI_MAX);
+	start = pinow();
+	lock_acquire(pilock);
+	piwaitns = pinow() - start;
+	lock_release(pilock);
+	V(donesem);
+}
+
+int
+pitest(int nargs, char **args)
+{
+	unsigned long i;
+	int result;
+	bool ok;
+
+	(void)nargs;
+	(void)args;
+
+	inititems();
+	pilock = lock_create("pilock");
+	piheld = sem_create("piheld", 0);
+	if (pilock == NULL || piheld == NULL) {
+		panic("pitest: out of memory\n");
+	}
+	pistop = false;
+	piwaitns = 0;
+
+	kprintf("Starting priority inheritance test...\n");
+	result = thread_fork("pilow", NULL, pilowthread, NULL, 0);
+	if (result) {
+		panic("pitest: thread_fork failed: %s\n", strerror(result));
+	}
+	P(piheld);
+	for (i=0; i<NPIMEDIUM; i++) {
+		result = thread_fork("pimedium", NULL, pimediumthread,
+				     NULL, i);
+		if (result) {
+			panic("pitest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	result = thread_fork("pihigh", NULL, pihighthread, NULL, 0);
+	if (result) {
+		panic("pitest: thread_fork failed: %s\n", strerror(result));
+	}
+
+	clocksleep(PITESTTIME);
+	pistop = true;
+	for (i=0; i<NPIMEDIUM + 2; i++) {
+		P(donesem);
+	}
+
+	/*
+	 * The high thread should have waited about as long as the low
+	 * thread held the lock, plus a few scheduling quanta; certainly
+	 * not for most of the time the medium threads were running.
+	 */
+	ok = piwaitns < PITESTTIME * 1000000000ULL / 2;
+	kprintf("High-priority thread waited %llu ms for the lock "
+		"(holder works %u ms, medium threads ran %u s)\n",
+		piwaitns / 1000000, PIHOLDMS, PITESTTIME);
+
+	sem_destroy(piheld);
+	lock_destroy(pilock);
+	piheld = NULL;
+	pilock = NULL;
+#ifdef UW
+	cleanitems();
+#endif
+	if (!ok) {
+		panic("pitest: high-priority thread was starved; "
+		      "priority inheritance failed\n");
+	}
+	kprintf("Priority inheritance test done.\n");
+
+	return 0;
+}
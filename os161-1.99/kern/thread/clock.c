@@ -35,6 +35,9 @@
 #include <thread.h>
 #include <lamebus/ltimer.h>
 #include <current.h>
+#include <kstat.h>
+#include <pollq.h>
+#include <kdata.h>
 
 /*
  * Time handling.
@@ -73,6 +76,11 @@ static struct wchan *minibolt;
  */
 static int minicount;
 
+/*
+ * Total hardclock() calls, all cpus.
+ */
+static struct kstat ks_hardclocks = KSTAT_COUNTER("sched.hardclocks");
+
 /*
  * Setup.
  */
@@ -90,6 +98,7 @@ hardclock_bootstrap(void)
 	minicount = MINI_PER_SECOND;
 	/* we assume MINI_PER_SECOND > 0 */
 	KASSERT(minicount > 0);
+	kstat_register(&ks_hardclocks);
 }
 
 /*
@@ -106,6 +115,10 @@ timerclock(void)
 	  minicount = MINI_PER_SECOND;
 	  wchan_wakeall(lbolt);
 	}
+	/* Let timed poll() calls check their deadlines */
+	pollq_timerclock();
+	/* Advance the time user programs see without a syscall */
+	kdata_timerclock();
 }
 
 /*
@@ -120,6 +133,7 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	kstat_inc(&ks_hardclocks);
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
@@ -0,0 +1,263 @@
+/*
+ * Lock contention profiling. See <lockstat.h>.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <lockstat.h>
+
+/* Number of distinct lock names we can keep track of. Power of 2. */
+#define LOCKSTAT_MAX		256
+/* Significant characters of a lock name. */
+#define LOCKSTAT_NAMELEN	24
+
+struct lockstat {
+	bool ls_used;
+	int ls_kind;
+	char ls_name[LOCKSTAT_NAMELEN];	/* empty if keyed by site */
+	const void *ls_site;
+	uint32_t ls_acquires;		/* total acquisitions */
+	uint32_t ls_contended;		/* acquisitions that had to wait */
+	uint64_t ls_waittime;		/* total time spent waiting */
+	uint64_t ls_maxwait;		/* longest single wait */
+	uint64_t ls_holdtime;		/* total time held */
+};
+
+volatile bool lockstat_enabled = false;
+
+static struct lockstat lockstats[LOCKSTAT_MAX];
+static unsigned lockstat_overflows;
+
+/*
+ * The table is protected by a bare spin word rather than a struct
+ * spinlock, since struct spinlocks call in here.
+ */
+static volatile spinlock_data_t lockstat_word = SPINLOCK_DATA_INITIALIZER;
+
+static
+void
+lockstat_lock(void)
+{
+	splraise(IPL_NONE, IPL_HIGH);
+	while (spinlock_data_get(&lockstat_word) != 0 ||
+	       spinlock_data_testandset(&lockstat_word) != 0) {
+		/* spin */
+	}
+}
+
+static
+void
+lockstat_unlock(void)
+{
+	spinlock_data_set(&lockstat_word, 0);
+	spllower(IPL_HIGH, IPL_NONE);
+}
+
+static
+unsigned
+lockstat_hash(int kind, const char *name, const void *site)
+{
+	unsigned h = kind;
+
+	if (name != NULL && name[0] != 0) {
+		while (*name) {
+			h = h*33 + (unsigned char)*name++;
+		}
+	}
+	else {
+		h = h*33 + (unsigned)(uintptr_t)site;
+	}
+	return h % LOCKSTAT_MAX;
+}
+
+/*
+ * Compare NAME to a stored (possibly truncated) name.
+ */
+static
+bool
+lockstat_samename(const char *stored, const char *name)
+{
+	unsigned i;
+
+	for (i=0; i<LOCKSTAT_NAMELEN-1; i++) {
+		if (stored[i] != name[i]) {
+			return false;
+		}
+		if (name[i] == 0) {
+			return true;
+		}
+	}
+	return true;
+}
+
+static
+bool
+lockstat_matches(struct lockstat *ls, int kind, const char *name,
+		 const void *site)
+{
+	if (ls->ls_kind != kind) {
+		return false;
+	}
+	if (name != NULL && name[0] != 0) {
+		return lockstat_samename(ls->ls_name, name);
+	}
+	return ls->ls_name[0] == 0 && ls->ls_site == site;
+}
+
+struct lockstat *
+lockstat_get(int kind, const char *name, const void *site)
+{
+	struct lockstat *ls;
+	unsigned i, n;
+
+	lockstat_lock();
+	i = lockstat_hash(kind, name, site);
+	for (n=0; n<LOCKSTAT_MAX; n++) {
+		ls = &lockstats[(i + n) % LOCKSTAT_MAX];
+		if (!ls->ls_used) {
+			ls->ls_used = true;
+			ls->ls_kind = kind;
+			if (name != NULL) {
+				snprintf(ls->ls_name, LOCKSTAT_NAMELEN,
+					 "%s", name);
+			}
+			ls->ls_site = site;
+			lockstat_unlock();
+			return ls;
+		}
+		if (lockstat_matches(ls, kind, name, site)) {
+			lockstat_unlock();
+			return ls;
+		}
+	}
+	lockstat_overflows++;
+	lockstat_unlock();
+	return NULL;
+}
+
+uint64_t
+lockstat_now(void)
+{
+	time_t secs;
+	uint32_t nsecs;
+
+	gettime(&secs, &nsecs);
+	return (uint64_t)secs * 1000000000 + nsecs;
+}
+
+void
+lockstat_acquired(struct lockstat *ls, bool contended, uint64_t wait)
+{
+	lockstat_lock();
+	ls->ls_acquires++;
+	if (contended) {
+		ls->ls_contended++;
+		ls->ls_waittime += wait;
+		if (wait > ls->ls_maxwait) {
+			ls->ls_maxwait = wait;
+		}
+	}
+	lockstat_unlock();
+}
+
+void
+lockstat_released(struct lockstat *ls, uint64_t hold)
+{
+	lockstat_lock();
+	ls->ls_holdtime += hold;
+	lockstat_unlock();
+}
+
+void
+lockstat_enable(bool on)
+{
+	lockstat_enabled = on;
+}
+
+void
+lockstat_clear(void)
+{
+	unsigned i;
+
+	lockstat_lock();
+	for (i=0; i<LOCKSTAT_MAX; i++) {
+		lockstats[i].ls_acquires = 0;
+		lockstats[i].ls_contended = 0;
+		lockstats[i].ls_waittime = 0;
+		lockstats[i].ls_maxwait = 0;
+		lockstats[i].ls_holdtime = 0;
+	}
+	lockstat_overflows = 0;
+	lockstat_unlock();
+}
+
+/*
+ * Print the MAX records with the most total wait time.
+ *
+ * Take a snapshot first: kprintf and kmalloc use spinlocks, so they
+ * can't be called with the table locked.
+ */
+void
+lockstat_print(unsigned max)
+{
+	struct lockstat *snap, *ls, tmp;
+	unsigned i, j, num, overflows;
+
+	snap = kmalloc(LOCKSTAT_MAX * sizeof(*snap));
+	if (snap == NULL) {
+		kprintf("lockstat: out of memory\n");
+		return;
+	}
+
+	num = 0;
+	lockstat_lock();
+	for (i=0; i<LOCKSTAT_MAX; i++) {
+		if (lockstats[i].ls_used && lockstats[i].ls_acquires > 0) {
+			snap[num++] = lockstats[i];
+		}
+	}
+	overflows = lockstat_overflows;
+	lockstat_unlock();
+
+	/* Selection sort of the first MAX, by total wait time. */
+	if (max > num) {
+		max = num;
+	}
+	for (i=0; i<max; i++) {
+		for (j=i+1; j<num; j++) {
+			if (snap[j].ls_waittime > snap[i].ls_waittime) {
+				tmp = snap[i];
+				snap[i] = snap[j];
+				snap[j] = tmp;
+			}
+		}
+	}
+
+	kprintf("lockstat: %s, %u locks seen\n",
+		lockstat_enabled ? "collecting" : "stopped", num);
+	kprintf("%-24s %5s %9s %9s %12s %10s %12s\n", "name", "kind",
+		"acquires", "contended", "wait(us)", "maxwait", "hold(us)");
+	for (i=0; i<max; i++) {
+		ls = &snap[i];
+		if (ls->ls_name[0] != 0) {
+			kprintf("%-24s ", ls->ls_name);
+		}
+		else {
+			kprintf("@%-23p ", ls->ls_site);
+		}
+		kprintf("%5s %9u %9u %12llu %10llu %12llu\n",
+			ls->ls_kind == LOCKSTAT_SPIN ? "spin" : "sleep",
+			ls->ls_acquires, ls->ls_contended,
+			ls->ls_waittime / 1000, ls->ls_maxwait / 1000,
+			ls->ls_holdtime / 1000);
+	}
+	if (overflows > 0) {
+		kprintf("lockstat: %u locks not tracked (table full)\n",
+			overflows);
+	}
+
+	kfree(snap);
+}
@@ -0,0 +1,59 @@
+/*
+ * Per-cpu counters. See <percpu.h>.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <cpu.h>
+#include <current.h>
+#include <percpu.h>
+
+void
+percpu_counter_init(struct percpu_counter *pc)
+{
+	percpu_counter_reset(pc);
+}
+
+void
+percpu_counter_add(struct percpu_counter *pc, unsigned n)
+{
+	int spl;
+
+	/*
+	 * Interrupts off so we can't be preempted and migrated between
+	 * finding our slot and updating it. Before curcpu exists only
+	 * the boot cpu is running, and it is cpu 0.
+	 */
+	spl = splhigh();
+	if (CURCPU_EXISTS()) {
+		KASSERT(curcpu->c_number < MAXCPUS);
+		pc->pc_count[curcpu->c_number] += n;
+	}
+	else {
+		pc->pc_count[0] += n;
+	}
+	splx(spl);
+}
+
+uint64_t
+percpu_counter_read(struct percpu_counter *pc)
+{
+	uint64_t total = 0;
+	unsigned i;
+
+	for (i=0; i<MAXCPUS; i++) {
+		total += pc->pc_count[i];
+	}
+	return total;
+}
+
+void
+percpu_counter_reset(struct percpu_counter *pc)
+{
+	unsigned i;
+
+	for (i=0; i<MAXCPUS; i++) {
+		pc->pc_count[i] = 0;
+	}
+}
@@ -0,0 +1,167 @@
+/*
+ * Poll wait queues. See <pollq.h>.
+ *
+ * Each time a waiter goes on a queue it gets a struct pollent, which
+ * is on both the queue's list and the waiter's. Only the waiter ever
+ * adds or frees its entries, always with the queue's lock held, so
+ * pollq_wake can look at the waiter through any entry it finds on the
+ * queue.
+ *
+ * The waiter sleeps on its own wchan; it locks the wchan before
+ * dropping pw_lock, and pollq_wake sets pw_woken under pw_lock before
+ * waking the wchan, so a wakeup can't slip in between the check and
+ * the sleep.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <wchan.h>
+#include <pollq.h>
+
+struct pollent {
+	struct pollwaiter *pe_waiter;
+	struct pollq *pe_q;
+	struct pollent *pe_qnext;	/* next on pe_q */
+	struct pollent *pe_wnext;	/* next of pe_waiter's */
+};
+
+/* Waiters with a timeout, woken on every tick. */
+static struct pollq poll_timerq = POLLQ_INITIALIZER;
+
+void
+pollq_init(struct pollq *pq)
+{
+	spinlock_init(&pq->pq_lock);
+	pq->pq_head = NULL;
+}
+
+void
+pollq_cleanup(struct pollq *pq)
+{
+	KASSERT(pq->pq_head == NULL);
+	spinlock_cleanup(&pq->pq_lock);
+}
+
+int
+pollq_add(struct pollq *pq, struct pollwaiter *pw)
+{
+	struct pollent *pe;
+
+	pe = kmalloc(sizeof(*pe));
+	if (pe == NULL) {
+		return ENOMEM;
+	}
+	pe->pe_waiter = pw;
+	pe->pe_q = pq;
+	pe->pe_wnext = pw->pw_ents;
+	pw->pw_ents = pe;
+
+	spinlock_acquire(&pq->pq_lock);
+	pe->pe_qnext = pq->pq_head;
+	pq->pq_head = pe;
+	spinlock_release(&pq->pq_lock);
+	return 0;
+}
+
+void
+pollq_wake(struct pollq *pq)
+{
+	struct pollent *pe;
+	struct pollwaiter *pw;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pe = pq->pq_head; pe != NULL; pe = pe->pe_qnext) {
+		pw = pe->pe_waiter;
+		spinlock_acquire(&pw->pw_lock);
+		pw->pw_woken = true;
+		spinlock_release(&pw->pw_lock);
+		wchan_wakeall(pw->pw_wchan);
+	}
+	spinlock_release(&pq->pq_lock);
+}
+
+/*
+ * Take PE off its queue and free it.
+ */
+static
+void
+pollent_remove(struct pollent *pe)
+{
+	struct pollq *pq = pe->pe_q;
+	struct pollent **pp;
+
+	spinlock_acquire(&pq->pq_lock);
+	for (pp = &pq->pq_head; *pp != pe; pp = &(*pp)->pe_qnext) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = pe->pe_qnext;
+	spinlock_release(&pq->pq_lock);
+	kfree(pe);
+}
+
+int
+pollwaiter_init(struct pollwaiter *pw)
+{
+	pw->pw_wchan = wchan_create("poll");
+	if (pw->pw_wchan == NULL) {
+		return ENOMEM;
+	}
+	spinlock_init(&pw->pw_lock);
+	pw->pw_woken = false;
+	pw->pw_ents = NULL;
+	return 0;
+}
+
+void
+pollwaiter_cleanup(struct pollwaiter *pw)
+{
+	KASSERT(pw->pw_ents == NULL);
+	spinlock_cleanup(&pw->pw_lock);
+	wchan_destroy(pw->pw_wchan);
+}
+
+int
+pollwaiter_wait(struct pollwaiter *pw, bool timed)
+{
+	int result = 0;
+
+	if (timed) {
+		result = pollq_add(&poll_timerq, pw);
+	}
+
+	if (result == 0) {
+		spinlock_acquire(&pw->pw_lock);
+		if (!pw->pw_woken) {
+			wchan_lock(pw->pw_wchan);
+			spinlock_release(&pw->pw_lock);
+			wchan_sleep(pw->pw_wchan);
+		}
+		else {
+			spinlock_release(&pw->pw_lock);
+		}
+	}
+
+	pollwaiter_clear(pw);
+	return result;
+}
+
+void
+pollwaiter_clear(struct pollwaiter *pw)
+{
+	struct pollent *pe;
+
+	while (pw->pw_ents != NULL) {
+		pe = pw->pw_ents;
+		pw->pw_ents = pe->pe_wnext;
+		pollent_remove(pe);
+	}
+
+	/* off every queue now, so nobody else can touch pw_woken */
+	pw->pw_woken = false;
+}
+
+void
+pollq_timerclock(void)
+{
+	pollq_wake(&poll_timerq);
+}
@@ -36,11 +36,17 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <current.h>	/* for curcpu */
+#include <lockstat.h>
 
 /*
  * Spinlocks.
  */
 
+/*
+ * Queue nodes for queued spinlocks taken before curcpu exists. Only
+ * the boot CPU is running then.
+ */
+static struct spinlock_qnode spinlock_bootqnodes[SPINLOCK_QNODES];
 
 /*
  * Initialize spinlock.
@@ -50,6 +56,37 @@ spinlock_init(struct spinlock *lk)
 {
 	spinlock_data_set(&lk->lk_lock, 0);
 	lk->lk_holder = NULL;
+	lk->lk_queued = false;
+	lk->lk_qnode = NULL;
+#if OPT_LOCKSTAT
+	lk->lk_name = NULL;
+	lk->lk_stat = NULL;
+	lk->lk_acquired = 0;
+#endif
+}
+
+/*
+ * Initialize a queued (MCS) spinlock.
+ */
+void
+spinlock_init_queued(struct spinlock *lk)
+{
+	spinlock_init(lk);
+	lk->lk_queued = true;
+}
+
+/*
+ * Name the spinlock, for lock profiling.
+ */
+void
+spinlock_setname(struct spinlock *lk, const char *name)
+{
+#if OPT_LOCKSTAT
+	lk->lk_name = name;
+#else
+	(void)lk;
+	(void)name;
+#endif
 }
 
 /*
@@ -62,6 +99,27 @@ spinlock_cleanup(struct spinlock *lk)
 	KASSERT(spinlock_data_get(&lk->lk_lock) == 0);
 }
 
+/*
+ * Get a free queue node for a queued spinlock. Interrupts are off, so
+ * nobody else on this CPU can be looking at the nodes.
+ */
+static
+struct spinlock_qnode *
+spinlock_qnode_get(struct cpu *mycpu)
+{
+	struct spinlock_qnode *nodes;
+	unsigned i;
+
+	nodes = (mycpu != NULL) ? mycpu->c_qnodes : spinlock_bootqnodes;
+	for (i=0; i<SPINLOCK_QNODES; i++) {
+		if (!nodes[i].q_inuse) {
+			nodes[i].q_inuse = true;
+			return &nodes[i];
+		}
+	}
+	panic("Too many queued spinlocks held on one cpu\n");
+}
+
 /*
  * Get the lock.
  *
@@ -73,6 +131,10 @@ void
 spinlock_acquire(struct spinlock *lk)
 {
 	struct cpu *mycpu;
+#if OPT_LOCKSTAT
+	bool contended = false;
+	uint64_t start = 0;
+#endif
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -87,27 +149,76 @@ spinlock_acquire(struct spinlock *lk)
 		mycpu = NULL;
 	}
 
-	while (1) {
+	if (lk->lk_queued) {
+		struct spinlock_qnode *node, *pred;
+
 		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
+		 * Queued lock: atomically put our node at the tail of
+		 * the queue. If there was somebody ahead of us, link
+		 * ourselves behind them and spin on our own node until
+		 * they hand us the lock.
 		 */
-		if (spinlock_data_get(&lk->lk_lock) != 0) {
-			continue;
+		node = spinlock_qnode_get(mycpu);
+		node->q_next = NULL;
+		node->q_waiting = true;
+		pred = (struct spinlock_qnode *)(uintptr_t)
+			spinlock_data_swap(&lk->lk_lock,
+					   (spinlock_data_t)(uintptr_t)node);
+		if (pred != NULL) {
+#if OPT_LOCKSTAT
+			if (lockstat_enabled) {
+				contended = true;
+				start = lockstat_now();
+			}
+#endif
+			pred->q_next = node;
+			while (node->q_waiting) {
+				/* spin */
+			}
 		}
-		if (spinlock_data_testandset(&lk->lk_lock) != 0) {
-			continue;
+		lk->lk_qnode = node;
+	}
+	else {
+		while (1) {
+			/*
+			 * Do test-test-and-set, that is, read first before
+			 * doing test-and-set, to reduce bus contention.
+			 *
+			 * Test-and-set is a machine-level atomic operation
+			 * that writes 1 into the lock word and returns the
+			 * previous value. If that value was 0, the lock was
+			 * previously unheld and we now own it. If it was 1,
+			 * we don't.
+			 */
+			if (spinlock_data_get(&lk->lk_lock) != 0 ||
+			    spinlock_data_testandset(&lk->lk_lock) != 0) {
+#if OPT_LOCKSTAT
+				if (!contended && lockstat_enabled) {
+					contended = true;
+					start = lockstat_now();
+				}
+#endif
+				continue;
+			}
+			break;
 		}
-		break;
 	}
 
 	lk->lk_holder = mycpu;
+
+#if OPT_LOCKSTAT
+	if (lockstat_enabled) {
+		if (lk->lk_stat == NULL) {
+			lk->lk_stat = lockstat_get(LOCKSTAT_SPIN, lk->lk_name,
+					__builtin_return_address(0));
+		}
+		lk->lk_acquired = lockstat_now();
+		if (lk->lk_stat != NULL) {
+			lockstat_acquired(lk->lk_stat, contended,
+					  contended ? lk->lk_acquired - start : 0);
+		}
+	}
+#endif
 }
 
 /*
@@ -121,8 +232,43 @@ spinlock_release(struct spinlock *lk)
 		KASSERT(lk->lk_holder == curcpu->c_self);
 	}
 
+#if OPT_LOCKSTAT
+	if (lk->lk_acquired != 0) {
+		if (lockstat_enabled && lk->lk_stat != NULL) {
+			lockstat_released(lk->lk_stat,
+					  lockstat_now() - lk->lk_acquired);
+		}
+		lk->lk_acquired = 0;
+	}
+#endif
+
 	lk->lk_holder = NULL;
-	spinlock_data_set(&lk->lk_lock, 0);
+	if (lk->lk_queued) {
+		struct spinlock_qnode *node = lk->lk_qnode;
+
+		/*
+		 * If nobody is queued behind us, swing the tail back to
+		 * empty. If that fails, somebody has just swapped
+		 * themselves in but hasn't linked to us yet; wait for
+		 * the link. Then pass the lock to them. Once we clear
+		 * their q_waiting the lock is theirs, so don't touch it
+		 * after that.
+		 */
+		lk->lk_qnode = NULL;
+		if (node->q_next != NULL ||
+		    spinlock_data_cas(&lk->lk_lock,
+				      (spinlock_data_t)(uintptr_t)node, 0)
+		    != (spinlock_data_t)(uintptr_t)node) {
+			while (node->q_next == NULL) {
+				/* spin */
+			}
+			node->q_next->q_waiting = false;
+		}
+		node->q_inuse = false;
+	}
+	else {
+		spinlock_data_set(&lk->lk_lock, 0);
+	}
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
@@ -39,6 +39,7 @@
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <lockstat.h>
 
 ////////////////////////////////////////////////////////////
 //
@@ -70,6 +71,7 @@ sem_create(const char *name, int initial_count)
 	}
 
 	spinlock_init(&sem->sem_lock);
+	spinlock_setname(&sem->sem_lock, sem->sem_name);
         sem->sem_count = initial_count;
 
         return sem;
@@ -165,6 +167,12 @@ lock_create(const char *name)
         }
         
         lock->locked = false;
+        lock->curthread = NULL;
+        lock->lk_nextheld = NULL;
+#if OPT_LOCKSTAT
+        lock->lk_stat = NULL;
+        lock->lk_acquired = 0;
+#endif
         
         // add stuff here as needed
         
@@ -174,9 +182,10 @@ lock_create(const char *name)
                 return NULL;
         }
         spinlock_init(lock->spinlock);
+        spinlock_setname(lock->spinlock, lock->lk_name);
         
         /* Init wchan lock */
-        lock->wchan = wchan_create(name);
+        lock->wchan = wchan_create(lock->lk_name);
         
         return lock;
 }
@@ -198,22 +207,222 @@ lock_destroy(struct lock *lock)
         kfree(lock);
 }
 
+#if OPT_LOCKSTAT
+/*
+ * Lock profiling. Both are called with the lock's spinlock held.
+ * START is when the caller began waiting, if CONTENDED.
+ */
+static
+void
+lock_stat_acquired(struct lock *lock, bool contended, uint64_t start)
+{
+        if (!lockstat_enabled) {
+                return;
+        }
+        if (lock->lk_stat == NULL) {
+                lock->lk_stat = lockstat_get(LOCKSTAT_SLEEP, lock->lk_name,
+                                             NULL);
+        }
+        lock->lk_acquired = lockstat_now();
+        if (lock->lk_stat != NULL) {
+                lockstat_acquired(lock->lk_stat, contended,
+                                  contended ? lock->lk_acquired - start : 0);
+        }
+}
+
+static
+void
+lock_stat_released(struct lock *lock)
+{
+        if (lock->lk_acquired != 0 && lockstat_enabled &&
+            lock->lk_stat != NULL) {
+                lockstat_released(lock->lk_stat,
+                                  lockstat_now() - lock->lk_acquired);
+        }
+        lock->lk_acquired = 0;
+}
+#endif /* OPT_LOCKSTAT */
+
+/*
+ * Priority inheritance.
+ *
+ * Lock ownership, each thread's list of held locks, t_blockedon, and
+ * effective priorities are all changed under pi_lock, so that chains
+ * of "waits for lock held by" can be followed safely across locks.
+ * pi_lock nests inside the locks' own spinlocks and outside all wait
+ * channels.
+ */
+static struct spinlock pi_lock = SPINLOCK_QUEUED_INITIALIZER;
+
+/*
+ * Raise the holder of LOCK to at least PRI, and if it is itself
+ * waiting for a lock, that lock's holder, and so on. Stops at the
+ * first thread already running at PRI or higher, so it terminates
+ * even if the chain loops.
+ */
+static
+void
+pi_boost(struct lock *lock, int pri)
+{
+        struct thread *t;
+
+        KASSERT(spinlock_do_i_hold(&pi_lock));
+        while (lock != NULL) {
+                t = lock->curthread;
+                if (t == NULL || t->t_priority >= pri) {
+                        break;
+                }
+                t->t_priority = pri;
+                lock = t->t_blockedon;
+        }
+}
+
+/*
+ * Set T's effective priority from its base priority and the highest
+ * priority waiting on any lock it holds.
+ */
+static
+void
+pi_recompute(struct thread *t)
+{
+        struct lock *held;
+        int pri, wpri;
+
+        KASSERT(spinlock_do_i_hold(&pi_lock));
+        pri = t->t_basepri;
+        for (held = t->t_heldlocks; held != NULL; held = held->lk_nextheld) {
+                wpri = wchan_maxpriority(held->wchan);
+                if (wpri > pri) {
+                        pri = wpri;
+                }
+        }
+        t->t_priority = pri;
+}
+
+void
+lock_pi_update(struct thread *t)
+{
+        spinlock_acquire(&pi_lock);
+        pi_recompute(t);
+        spinlock_release(&pi_lock);
+}
+
+/*
+ * Make T (possibly NULL) the holder of LOCK, moving the lock from the
+ * old holder's list of held locks to T's and recomputing both their
+ * priorities. Must be called with the lock's spinlock held.
+ */
+static
+void
+lock_setowner(struct lock *lock, struct thread *t)
+{
+        struct thread *old;
+        struct lock **pp;
+
+        KASSERT(spinlock_do_i_hold(lock->spinlock));
+
+        spinlock_acquire(&pi_lock);
+        old = lock->curthread;
+        if (old != NULL) {
+                for (pp = &old->t_heldlocks; *pp != lock;
+                     pp = &(*pp)->lk_nextheld) {
+                        KASSERT(*pp != NULL);
+                }
+                *pp = lock->lk_nextheld;
+                lock->lk_nextheld = NULL;
+        }
+        lock->locked = (t != NULL);
+        lock->curthread = t;
+        if (t != NULL) {
+                t->t_blockedon = NULL;
+                lock->lk_nextheld = t->t_heldlocks;
+                t->t_heldlocks = lock;
+        }
+        if (old != NULL) {
+                pi_recompute(old);
+        }
+        if (t != NULL) {
+                pi_recompute(t);
+        }
+        spinlock_release(&pi_lock);
+}
+
+/*
+ * Note that the current thread is about to wait for LOCK, and lend
+ * its priority to the holder. Must be called with the lock's
+ * spinlock held.
+ */
+static
+void
+lock_pi_block(struct lock *lock)
+{
+        KASSERT(spinlock_do_i_hold(lock->spinlock));
+
+        spinlock_acquire(&pi_lock);
+        curthread->t_blockedon = lock;
+        pi_boost(lock, curthread->t_priority);
+        spinlock_release(&pi_lock);
+}
+
+/*
+ * Pass the lock to the first thread waiting for it, or mark it free
+ * if nobody is. Must be called with the lock's spinlock held.
+ *
+ * The woken thread owns the lock as soon as it is made runnable, so
+ * it does not have to race the other CPUs to re-take the lock and
+ * possibly lose and go back to sleep. Waiters get the lock in FIFO
+ * order.
+ */
+static
+void
+lock_handoff(struct lock *lock)
+{
+        struct thread *next;
+
+        KASSERT(spinlock_do_i_hold(lock->spinlock));
+#if OPT_LOCKSTAT
+        lock_stat_released(lock);
+#endif
+        next = wchan_wakehead(lock->wchan);
+        lock_setowner(lock, next);
+}
+
 void
 lock_acquire(struct lock *lock)
 {
+#if OPT_LOCKSTAT
+        bool contended;
+        uint64_t start = 0;
+#endif
+
         KASSERT(lock);
-        // Write this
+        KASSERT(curthread->t_in_interrupt == false);
+
         spinlock_acquire(lock->spinlock);
         // Check dead lock
         KASSERT(! lock_do_i_hold(lock)); 
-        while(lock->locked) {
+#if OPT_LOCKSTAT
+        contended = lock->locked;
+        if (contended && lockstat_enabled) {
+                start = lockstat_now();
+        }
+#endif
+        if (lock->locked) {
+                lock_pi_block(lock);
                 wchan_lock(lock->wchan);
                 spinlock_release(lock->spinlock);
                 wchan_sleep(lock->wchan);
+                /* lock_handoff() made us the owner before waking us */
                 spinlock_acquire(lock->spinlock);
+                KASSERT(lock->locked);
+                KASSERT(lock_do_i_hold(lock));
+        }
+        else {
+                lock_setowner(lock, curthread);
         }
-        lock->locked = true;
-        lock->curthread = curthread;
+#if OPT_LOCKSTAT
+        lock_stat_acquired(lock, contended, start);
+#endif
         spinlock_release(lock->spinlock);
 }
 
@@ -221,13 +430,11 @@ void
 lock_release(struct lock *lock)
 {
         KASSERT(lock);
-        // Write this
+
         spinlock_acquire(lock->spinlock);
         // Check ownership
         KASSERT(lock_do_i_hold(lock));
-        lock->locked = false;
-        lock->curthread = NULL;
-        wchan_wakeone(lock->wchan);
+        lock_handoff(lock);
         spinlock_release(lock->spinlock);
 }
 
@@ -263,7 +470,7 @@ cv_create(const char *name)
         // add stuff here as needed
         
         /* Init Wchan*/
-        cv->wchan = wchan_create(name);
+        cv->wchan = wchan_create(cv->cv_name);
         
         return cv;
 }
@@ -283,37 +490,265 @@ cv_destroy(struct cv *cv)
 void
 cv_wait(struct cv *cv, struct lock *lock)
 {
-        // Write this
         KASSERT(cv);
         KASSERT(lock);
         KASSERT(lock_do_i_hold(lock));
-        
+
+        /*
+         * Release the lock and go to sleep atomically with respect to
+         * cv_signal and cv_broadcast, which hold the lock's spinlock
+         * while they look at the CV.
+         */
+        spinlock_acquire(lock->spinlock);
+        lock_handoff(lock);
+        /*
+         * We don't count as blocked on the lock for priority
+         * inheritance while asleep on the CV; cv_wake sets
+         * t_blockedon when it queues us on the lock.
+         */
         wchan_lock(cv->wchan);
-        lock_release(lock);
+        spinlock_release(lock->spinlock);
         wchan_sleep(cv->wchan);
-        lock_acquire(lock);
+
+        /*
+         * We were moved onto the lock's wait channel and then handed
+         * the lock, or handed it directly if it was free; either way
+         * we own it now.
+         */
+        spinlock_acquire(lock->spinlock);
+        KASSERT(lock->locked);
+        KASSERT(lock_do_i_hold(lock));
+#if OPT_LOCKSTAT
+        lock_stat_acquired(lock, false, 0);
+#endif
+        spinlock_release(lock->spinlock);
 }
 
+/* wchan_requeue callback: T has moved from a CV onto LOCK's queue. */
+static
 void
-cv_signal(struct cv *cv, struct lock *lock)
+cv_requeued(struct thread *t, void *lock)
 {
-        // Write this
+        KASSERT(spinlock_do_i_hold(&pi_lock));
+        t->t_blockedon = lock;
+}
+
+/*
+ * Common code for cv_signal and cv_broadcast.
+ *
+ * Rather than waking the CV's waiters only to have them all pile up
+ * on the lock (which the caller normally still holds), requeue them
+ * directly onto the lock's wait channel ("wait morphing"). They are
+ * then woken one at a time, already owning the lock, as it is
+ * released. If the lock happens to be free, the first waiter is
+ * given the lock and woken right away.
+ */
+static
+void
+cv_wake(struct cv *cv, struct lock *lock, bool all)
+{
+        struct thread *next;
+
         KASSERT(cv);
-        (void)lock;
-        // KASSERT(lock);
-        // KASSERT(lock_do_i_hold(lock));
-        
-        wchan_wakeone(cv->wchan);
+        KASSERT(lock);
+
+        spinlock_acquire(lock->spinlock);
+        if (! lock->locked) {
+                next = wchan_wakehead(cv->wchan);
+                if (next == NULL) {
+                        spinlock_release(lock->spinlock);
+                        return;
+                }
+                lock_setowner(lock, next);
+                if (! all) {
+                        spinlock_release(lock->spinlock);
+                        return;
+                }
+        }
+        /* The requeued threads are now waiting for the lock. */
+        spinlock_acquire(&pi_lock);
+        if (wchan_requeue(cv->wchan, lock->wchan, all,
+                          cv_requeued, lock) > 0) {
+                pi_boost(lock, wchan_maxpriority(lock->wchan));
+        }
+        spinlock_release(&pi_lock);
+        spinlock_release(lock->spinlock);
+}
+
+void
+cv_signal(struct cv *cv, struct lock *lock)
+{
+        cv_wake(cv, lock, false);
 }
 
 void
 cv_broadcast(struct cv *cv, struct lock *lock)
 {
-        // Write this
-        KASSERT(cv);
-        (void)lock;
-        // KASSERT(lock);
-        // KASSERT(lock_do_i_hold(lock));
-        
-        wchan_wakeall(cv->wchan);
+        cv_wake(cv, lock, true);
+}
+
+////////////////////////////////////////////////////////////
+//
+// Reader-writer lock.
+
+struct rwlock *
+rwlock_create(const char *name)
+{
+        struct rwlock *rw;
+
+        rw = kmalloc(sizeof(struct rwlock));
+        if (rw == NULL) {
+                return NULL;
+        }
+
+        rw->rw_name = kstrdup(name);
+        if (rw->rw_name == NULL) {
+                kfree(rw);
+                return NULL;
+        }
+
+        rw->rw_rwchan = wchan_create(rw->rw_name);
+        if (rw->rw_rwchan == NULL) {
+                kfree(rw->rw_name);
+                kfree(rw);
+                return NULL;
+        }
+
+        rw->rw_wwchan = wchan_create(rw->rw_name);
+        if (rw->rw_wwchan == NULL) {
+                wchan_destroy(rw->rw_rwchan);
+                kfree(rw->rw_name);
+                kfree(rw);
+                return NULL;
+        }
+
+        spinlock_init(&rw->rw_lock);
+        rw->rw_readers = 0;
+        rw->rw_rwaiting = 0;
+        rw->rw_wwaiting = 0;
+        rw->rw_writer = NULL;
+
+        return rw;
+}
+
+void
+rwlock_destroy(struct rwlock *rw)
+{
+        KASSERT(rw != NULL);
+        KASSERT(rw->rw_readers == 0);
+        KASSERT(rw->rw_writer == NULL);
+
+        spinlock_cleanup(&rw->rw_lock);
+        wchan_destroy(rw->rw_wwchan);
+        wchan_destroy(rw->rw_rwchan);
+        kfree(rw->rw_name);
+        kfree(rw);
+}
+
+void
+rwlock_acquire_read(struct rwlock *rw)
+{
+        KASSERT(rw != NULL);
+        KASSERT(curthread->t_in_interrupt == false);
+
+        spinlock_acquire(&rw->rw_lock);
+        KASSERT(rw->rw_writer != curthread);
+        if (rw->rw_writer != NULL || rw->rw_wwaiting > 0) {
+                /*
+                 * Queue up behind the writers. The writer that
+                 * lets us in counts us in rw_readers before waking
+                 * us, so there is nothing to recheck afterwards.
+                 */
+                rw->rw_rwaiting++;
+                wchan_lock(rw->rw_rwchan);
+                spinlock_release(&rw->rw_lock);
+                wchan_sleep(rw->rw_rwchan);
+                return;
+        }
+        rw->rw_readers++;
+        spinlock_release(&rw->rw_lock);
+}
+
+void
+rwlock_release_read(struct rwlock *rw)
+{
+        KASSERT(rw != NULL);
+
+        spinlock_acquire(&rw->rw_lock);
+        KASSERT(rw->rw_readers > 0);
+        KASSERT(rw->rw_writer == NULL);
+        rw->rw_readers--;
+        if (rw->rw_readers == 0 && rw->rw_wwaiting > 0) {
+                /* Last reader out hands the lock to the next writer. */
+                rw->rw_wwaiting--;
+                rw->rw_writer = wchan_wakehead(rw->rw_wwchan);
+                KASSERT(rw->rw_writer != NULL);
+        }
+        spinlock_release(&rw->rw_lock);
+}
+
+void
+rwlock_acquire_write(struct rwlock *rw)
+{
+        KASSERT(rw != NULL);
+        KASSERT(curthread->t_in_interrupt == false);
+
+        spinlock_acquire(&rw->rw_lock);
+        KASSERT(rw->rw_writer != curthread);
+        if (rw->rw_writer != NULL || rw->rw_readers > 0) {
+                rw->rw_wwaiting++;
+                wchan_lock(rw->rw_wwchan);
+                spinlock_release(&rw->rw_lock);
+                wchan_sleep(rw->rw_wwchan);
+                /* Whoever woke us made us the writer first. */
+                spinlock_acquire(&rw->rw_lock);
+                KASSERT(rw->rw_writer == curthread);
+                KASSERT(rw->rw_readers == 0);
+        }
+        else {
+                rw->rw_writer = curthread;
+        }
+        spinlock_release(&rw->rw_lock);
+}
+
+void
+rwlock_release_write(struct rwlock *rw)
+{
+        KASSERT(rw != NULL);
+
+        spinlock_acquire(&rw->rw_lock);
+        KASSERT(rw->rw_writer == curthread);
+        KASSERT(rw->rw_readers == 0);
+        if (rw->rw_rwaiting > 0) {
+                /*
+                 * Let in every reader that queued up behind us, even
+                 * if more writers are waiting; otherwise a steady
+                 * stream of writers would starve them.
+                 */
+                rw->rw_writer = NULL;
+                rw->rw_readers = rw->rw_rwaiting;
+                rw->rw_rwaiting = 0;
+                wchan_wakeall(rw->rw_rwchan);
+        }
+        else if (rw->rw_wwaiting > 0) {
+                rw->rw_wwaiting--;
+                rw->rw_writer = wchan_wakehead(rw->rw_wwchan);
+                KASSERT(rw->rw_writer != NULL);
+        }
+        else {
+                rw->rw_writer = NULL;
+        }
+        spinlock_release(&rw->rw_lock);
+}
+
+bool
+rwlock_do_i_hold_write(struct rwlock *rw)
+{
+        return (rw->rw_writer == curthread);
+}
+
+bool
+rwlock_is_held(struct rwlock *rw)
+{
+        return (rw->rw_writer != NULL || rw->rw_readers > 0);
 }
@@ -47,6 +47,7 @@
 #include <proc.h>
 #include <current.h>
 #include <synch.h>
+#include <kstat.h>
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
@@ -72,6 +73,12 @@ static struct cpuarray allcpus;
 /* Used to wait for secondary CPUs to come online. */
 static struct semaphore *cpu_startup_sem;
 
+/* Statistics */
+static struct kstat ks_switches = KSTAT_COUNTER("sched.switches");
+static struct kstat ks_migrations = KSTAT_COUNTER("sched.migrations");
+static struct kstat ks_forks = KSTAT_COUNTER("thread.forks");
+static struct kstat ks_poolreuse = KSTAT_COUNTER("thread.pool_reuses");
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -111,6 +118,38 @@ thread_checkstack(struct thread *thread)
 	}
 }
 
+/*
+ * Initialize the fields of a thread structure, except the name.
+ */
+static
+void
+thread_init(struct thread *thread)
+{
+	thread->t_wchan_name = "NEW";
+	thread->t_state = S_READY;
+
+	/* Thread subsystem fields */
+	thread_machdep_init(&thread->t_machdep);
+	threadlistnode_init(&thread->t_listnode, thread);
+	thread->t_stack = NULL;
+	thread->t_context = NULL;
+	thread->t_cpu = NULL;
+	thread->t_proc = NULL;
+
+	/* Interrupt state fields */
+	thread->t_in_interrupt = false;
+	thread->t_curspl = IPL_HIGH;
+	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+
+	/* Scheduling priority */
+	thread->t_basepri = THREAD_PRI_DEFAULT;
+	thread->t_priority = THREAD_PRI_DEFAULT;
+	thread->t_blockedon = NULL;
+	thread->t_heldlocks = NULL;
+
+	/* If you add to struct thread, be sure to initialize here */
+}
+
 /*
  * Create a thread. This is used both to create a first thread
  * for each CPU and to create subsequent forked threads.
@@ -133,23 +172,7 @@ thread_create(const char *name)
 		kfree(thread);
 		return NULL;
 	}
-	thread->t_wchan_name = "NEW";
-	thread->t_state = S_READY;
-
-	/* Thread subsystem fields */
-	thread_machdep_init(&thread->t_machdep);
-	threadlistnode_init(&thread->t_listnode, thread);
-	thread->t_stack = NULL;
-	thread->t_context = NULL;
-	thread->t_cpu = NULL;
-	thread->t_proc = NULL;
-
-	/* Interrupt state fields */
-	thread->t_in_interrupt = false;
-	thread->t_curspl = IPL_HIGH;
-	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
-
-	/* If you add to struct thread, be sure to initialize here */
+	thread_init(thread);
 
 	return thread;
 }
@@ -167,6 +190,7 @@ cpu_create(unsigned hardware_number)
 {
 	struct cpu *c;
 	int result;
+	unsigned i;
 	char namebuf[16];
 
 	c = kmalloc(sizeof(*c));
@@ -179,7 +203,13 @@ cpu_create(unsigned hardware_number)
 
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
+	threadlist_init(&c->c_threadpool);
 	c->c_hardclocks = 0;
+	for (i=0; i<SPINLOCK_QNODES; i++) {
+		c->c_qnodes[i].q_next = NULL;
+		c->c_qnodes[i].q_waiting = false;
+		c->c_qnodes[i].q_inuse = false;
+	}
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -263,6 +293,76 @@ thread_destroy(struct thread *thread)
 	kfree(thread);
 }
 
+/*
+ * Thread pool.
+ *
+ * Rather than freeing dead threads, exorcise() keeps up to
+ * thread_poolmax of them, stack and all, on a per-cpu list, and
+ * thread_fork reuses them. This saves the kmalloc of a thread and its
+ * multi-page stack on every fork. The pool is only touched by its own
+ * cpu, with interrupts off, so it needs no lock. If thread_poolmax is
+ * lowered, each cpu frees its excess the next time it runs exorcise().
+ */
+unsigned thread_poolmax = THREAD_POOLMAX;
+
+/*
+ * Take a thread off this cpu's pool and set it up as if by
+ * thread_create, keeping its stack. Returns NULL if the pool is empty
+ * or we run out of memory for the name.
+ */
+static
+struct thread *
+thread_pool_get(const char *name)
+{
+	struct thread *thread;
+	void *stack;
+	int spl;
+
+	spl = splhigh();
+	thread = threadlist_remhead(&curcpu->c_threadpool);
+	splx(spl);
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	stack = thread->t_stack;
+	thread_init(thread);
+	thread->t_stack = stack;
+	thread->t_name = kstrdup(name);
+	if (thread->t_name == NULL) {
+		thread_destroy(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+ * Put a dead thread in this cpu's pool, if there's room. Its stack
+ * guard band is checked and left in place. Returns false if the
+ * thread should be destroyed instead. Called with interrupts off.
+ */
+static
+bool
+thread_pool_put(struct thread *thread)
+{
+	KASSERT(thread->t_proc == NULL);
+
+	if (thread->t_stack == NULL ||
+	    curcpu->c_threadpool.tl_count >= thread_poolmax) {
+		return false;
+	}
+	thread_checkstack(thread);
+
+	thread_machdep_cleanup(&thread->t_machdep);
+	kfree(thread->t_name);
+	thread->t_name = NULL;
+	thread->t_wchan_name = "POOLED";
+
+	threadlist_addtail(&curcpu->c_threadpool, thread);
+	return true;
+}
+
 /*
  * Clean up zombies. (Zombies are threads that have exited but still
  * need to have thread_destroy called on them.)
@@ -278,6 +378,14 @@ exorcise(void)
 	while ((z = threadlist_remhead(&curcpu->c_zombies)) != NULL) {
 		KASSERT(z != curthread);
 		KASSERT(z->t_state == S_ZOMBIE);
+		if (!thread_pool_put(z)) {
+			thread_destroy(z);
+		}
+	}
+
+	/* trim the pool if thread_poolmax has been lowered */
+	while (curcpu->c_threadpool.tl_count > thread_poolmax) {
+		z = threadlist_remhead(&curcpu->c_threadpool);
 		thread_destroy(z);
 	}
 }
@@ -381,6 +489,11 @@ thread_bootstrap(void)
 	/* cpu_create() should have set t_proc. */
 	KASSERT(curthread->t_proc != NULL);
 
+	kstat_register(&ks_switches);
+	kstat_register(&ks_migrations);
+	kstat_register(&ks_forks);
+	kstat_register(&ks_poolreuse);
+
 	/* Done */
 }
 
@@ -488,21 +601,28 @@ thread_fork(const char *name,
 	DEBUG(DB_THREADS,"Forking thread: %s\n",name);
 #endif // UW
 
-	newthread = thread_create(name);
-	if (newthread == NULL) {
-		return ENOMEM;
+	/* Reuse a thread and stack from the pool if we can */
+	newthread = thread_pool_get(name);
+	if (newthread != NULL) {
+		kstat_inc(&ks_poolreuse);
 	}
+	else {
+		newthread = thread_create(name);
+		if (newthread == NULL) {
+			return ENOMEM;
+		}
 
-	/* Allocate a stack */
-	newthread->t_stack = kmalloc(STACK_SIZE);
-	
-	// kprintf("thread_fork: %p\n", (void*)newthread->t_stack);
-	
-	if (newthread->t_stack == NULL) {
-		thread_destroy(newthread);
-		return ENOMEM;
+		/* Allocate a stack */
+		newthread->t_stack = kmalloc(STACK_SIZE);
+
+		// kprintf("thread_fork: %p\n", (void*)newthread->t_stack);
+
+		if (newthread->t_stack == NULL) {
+			thread_destroy(newthread);
+			return ENOMEM;
+		}
+		thread_checkstack_init(newthread);
 	}
-	thread_checkstack_init(newthread);
 
 	/*
 	 * Now we clone various fields from the parent thread.
@@ -510,6 +630,8 @@ thread_fork(const char *name,
 
 	/* Thread subsystem fields */
 	newthread->t_cpu = curthread->t_cpu;
+	newthread->t_basepri = curthread->t_basepri;
+	newthread->t_priority = curthread->t_basepri;
 
 	/* Attach the new thread to its process */
 	if (proc == NULL) {
@@ -535,9 +657,34 @@ thread_fork(const char *name,
 	/* Lock the current cpu's run queue and make the new thread runnable */
 	thread_make_runnable(newthread, false);
 
+	kstat_inc(&ks_forks);
 	return 0;
 }
 
+/*
+ * Take the highest-priority thread off a run queue; the first one
+ * if several are tied, so threads of equal priority go round-robin.
+ * Returns NULL if the queue is empty. The run queue must be locked.
+ */
+static
+struct thread *
+thread_remhighest(struct threadlist *rq)
+{
+	struct thread *t, *best;
+
+	if (threadlist_isempty(rq)) {
+		return NULL;
+	}
+	best = NULL;
+	THREADLIST_FORALL(t, *rq) {
+		if (best == NULL || t->t_priority > best->t_priority) {
+			best = t;
+		}
+	}
+	threadlist_remove(rq, best);
+	return best;
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -636,7 +783,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 	/* The current cpu is now idle. */
 	curcpu->c_isidle = true;
 	do {
-		next = threadlist_remhead(&curcpu->c_runqueue);
+		next = thread_remhighest(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
 			cpu_idle();
@@ -644,6 +791,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc)
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
+	kstat_inc(&ks_switches);
 
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
@@ -834,11 +982,25 @@ void
 schedule(void)
 {
 	/*
-	 * You can write this. If we do nothing, threads will run in
-	 * round-robin fashion.
+	 * Nothing to do: thread_switch picks the highest-priority
+	 * thread off the run queue (see thread_remhighest), and
+	 * threads of equal priority run in round-robin fashion.
 	 */
 }
 
+/*
+ * Set the current thread's base priority. Its effective priority may
+ * stay higher if it holds a lock that a higher-priority thread wants.
+ */
+void
+thread_setpriority(int pri)
+{
+	KASSERT(pri >= THREAD_PRI_MIN && pri <= THREAD_PRI_MAX);
+
+	curthread->t_basepri = pri;
+	lock_pi_update(curthread);
+}
+
 /*
  * Thread migration.
  *
@@ -929,6 +1091,7 @@ thread_consider_migration(void)
 
 			t->t_cpu = c;
 			threadlist_addtail(&c->c_runqueue, t);
+			kstat_inc(&ks_migrations);
 			DEBUG(DB_THREADS,
 			      "Migrated thread %s: cpu %u -> %u",
 			      t->t_name, curcpu->c_number, c->c_number);
@@ -985,6 +1148,7 @@ wchan_create(const char *name)
 		return NULL;
 	}
 	spinlock_init(&wc->wc_lock);
+	spinlock_setname(&wc->wc_lock, name);
 	threadlist_init(&wc->wc_threads);
 	wc->wc_name = name;
 	return wc;
@@ -1032,6 +1196,26 @@ wchan_sleep(struct wchan *wc)
 	thread_switch(S_SLEEP, wc);
 }
 
+/*
+ * Return the highest priority of the threads on a wait channel.
+ */
+int
+wchan_maxpriority(struct wchan *wc)
+{
+	struct thread *t;
+	int max = -1;
+
+	spinlock_acquire(&wc->wc_lock);
+	THREADLIST_FORALL(t, wc->wc_threads) {
+		if (t->t_priority > max) {
+			max = t->t_priority;
+		}
+	}
+	spinlock_release(&wc->wc_lock);
+
+	return max;
+}
+
 /*
  * Wake up one thread sleeping on a wait channel.
  */
@@ -1094,6 +1278,57 @@ wchan_wakeall(struct wchan *wc)
 	threadlist_cleanup(&list);
 }
 
+/*
+ * Wake up the thread at the head of a wait channel, and say which
+ * one it was.
+ */
+struct thread *
+wchan_wakehead(struct wchan *wc)
+{
+	struct thread *target;
+
+	spinlock_acquire(&wc->wc_lock);
+	target = threadlist_remhead(&wc->wc_threads);
+	spinlock_release(&wc->wc_lock);
+
+	if (target != NULL) {
+		thread_make_runnable(target, false);
+	}
+	return target;
+}
+
+/*
+ * Move sleeping threads from one wait channel to another. They stay
+ * asleep, in the same order, behind anything already waiting on TO.
+ */
+unsigned
+wchan_requeue(struct wchan *from, struct wchan *to, bool all,
+	      void (*moved)(struct thread *, void *), void *arg)
+{
+	struct thread *target;
+	unsigned count = 0;
+
+	KASSERT(from != to);
+
+	spinlock_acquire(&from->wc_lock);
+	spinlock_acquire(&to->wc_lock);
+	while ((target = threadlist_remhead(&from->wc_threads)) != NULL) {
+		target->t_wchan_name = to->wc_name;
+		threadlist_addtail(&to->wc_threads, target);
+		if (moved != NULL) {
+			moved(target, arg);
+		}
+		count++;
+		if (!all) {
+			break;
+		}
+	}
+	spinlock_release(&to->wc_lock);
+	spinlock_release(&from->wc_lock);
+
+	return count;
+}
+
 /*
  * Return nonzero if there are no threads sleeping on the channel.
  * This is meant to be used only for diagnostic purposes.
@@ -134,6 +134,21 @@ dev_ioctl(struct vnode *v, int op, userptr_t data)
 	return d->d_ioctl(d, op, data);
 }
 
+/*
+ * Called for poll(). Devices without d_poll never block.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, int *revents, struct pollwaiter *pw)
+{
+	struct device *d = v->vn_data;
+
+	if (d->d_poll == NULL) {
+		return vnode_pollready(v, events, revents, pw);
+	}
+	return d->d_poll(d, events, revents, pw);
+}
+
 /*
  * Called for stat().
  * Set the type and the size (block devices only).
@@ -423,6 +438,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	null_io,      /* getdirentry */
 	dev_write,
 	dev_ioctl,
+	dev_poll,
 	dev_stat,
 	dev_gettype,
 	dev_tryseek,
@@ -0,0 +1,133 @@
+/*
+ * The kernel statistics device, "kstat:". Reading it produces the
+ * current value of every registered statistic, one per line, in the
+ * format of kstat_format(). It can't be written.
+ *
+ * Each read generates a fresh snapshot and returns the part of it at
+ * the read's offset, so to get a consistent set of values, read the
+ * whole thing with one large read.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <uio.h>
+#include <vfs.h>
+#include <device.h>
+#include <kstat.h>
+
+/* For open() */
+static
+int
+kstatopen(struct device *dev, int openflags)
+{
+	(void)dev;
+	(void)openflags;
+
+	return 0;
+}
+
+/* For close() */
+static
+int
+kstatclose(struct device *dev)
+{
+	(void)dev;
+	return 0;
+}
+
+/* extra room for the snapshot growing while we allocate */
+#define KSTATIO_SLACK 64
+
+/* For d_io() */
+static
+int
+kstatio(struct device *dev, struct uio *uio)
+{
+	char *buf;
+	size_t alloc, len, amt;
+	int result;
+
+	(void)dev; // unused
+
+	if (uio->uio_rw == UIO_WRITE) {
+		return EINVAL;
+	}
+
+	/*
+	 * kstat_format returns the length the text needs, not what it
+	 * stored, and the text can grow between sizing the buffer and
+	 * filling it (a counter gains a digit, or the kmalloc here moves
+	 * kmalloc.bytes_used). Leave some slack and start over if the
+	 * snapshot still didn't fit, rather than hand out a cut-off one.
+	 */
+	len = kstat_format(NULL, 0);
+	do {
+		alloc = len + KSTATIO_SLACK;
+		buf = kmalloc(alloc);
+		if (buf == NULL) {
+			return ENOMEM;
+		}
+		len = kstat_format(buf, alloc);
+		if (len >= alloc) {
+			kfree(buf);
+		}
+	} while (len >= alloc);
+
+	if (uio->uio_offset >= (off_t)len) {
+		/* EOF */
+		kfree(buf);
+		return 0;
+	}
+	amt = len - uio->uio_offset;
+	if (amt > uio->uio_resid) {
+		amt = uio->uio_resid;
+	}
+	result = uiomove(buf + uio->uio_offset, amt, uio);
+	kfree(buf);
+	return result;
+}
+
+/* For ioctl() */
+static
+int
+kstatioctl(struct device *dev, int op, userptr_t data)
+{
+	(void)dev;
+	(void)op;
+	(void)data;
+
+	return EINVAL;
+}
+
+/*
+ * Function to create and attach kstat:
+ */
+void
+devkstat_create(void)
+{
+	int result;
+	struct device *dev;
+
+	dev = kmalloc(sizeof(*dev));
+	if (dev==NULL) {
+		panic("Could not add kstat device: out of memory\n");
+	}
+
+	dev->d_open = kstatopen;
+	dev->d_close = kstatclose;
+	dev->d_io = kstatio;
+	dev->d_ioctl = kstatioctl;
+	dev->d_poll = NULL;
+
+	dev->d_blocks = 0;
+	dev->d_blocksize = 1;
+
+	dev->d_devnumber = 0; /* assigned by vfs_adddev */
+
+	dev->d_data = NULL;
+
+	result = vfs_adddev("kstat", dev, 0);
+	if (result) {
+		panic("Could not add kstat device: %s\n", strerror(result));
+	}
+}
@@ -0,0 +1,548 @@
+/*
+ * Anonymous pipes. See <pipe.h>.
+ *
+ * A pipe is a page-sized circular buffer shared by two vnodes, one
+ * for each end. pp_lock protects everything in the pipe; readers wait
+ * on pp_readcv for data and writers on pp_writecv for space.
+ *
+ * Wakeups are batched to the transitions that matter. Readers only
+ * sleep on an empty pipe, so they are woken only when it goes from
+ * empty to nonempty. Writers record in pp_writewant how much space
+ * they are waiting for (1 byte, or the whole write if it must be
+ * atomic), and are woken only when a read takes the free space from
+ * below that to at least that, not on every read.
+ *
+ * poll() waiters go on pp_readpq and pp_writepq and are woken at the
+ * same points; one waiting to write counts as wanting PIPE_BUF bytes.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/poll.h>
+#include <limits.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <vm.h>
+#include <vnode.h>
+#include <kstat.h>
+#include <pollq.h>
+#include <pipe.h>
+
+#define PIPE_SIZE	PAGE_SIZE
+
+struct pipe {
+	struct lock *pp_lock;
+	struct cv *pp_readcv;
+	struct cv *pp_writecv;
+	struct pollq pp_readpq;
+	struct pollq pp_writepq;
+	char *pp_buf;			/* PIPE_SIZE bytes */
+	unsigned pp_head;		/* index of the oldest byte */
+	unsigned pp_count;		/* bytes in the buffer */
+	unsigned pp_writewant;		/* space sleeping writers need, or 0 */
+	bool pp_readopen;		/* read end still open */
+	bool pp_writeopen;		/* write end still open */
+	struct vnode pp_readvn;
+	struct vnode pp_writevn;
+};
+
+static struct kstat ks_bytes = KSTAT_COUNTER("pipe.bytes");
+static struct kstat ks_sleeps = KSTAT_COUNTER("pipe.sleeps");
+static struct kstat ks_wakeups = KSTAT_COUNTER("pipe.wakeups");
+
+static
+void
+pipe_destroy(struct pipe *pp)
+{
+	pollq_cleanup(&pp->pp_writepq);
+	pollq_cleanup(&pp->pp_readpq);
+	if (pp->pp_writecv != NULL) {
+		cv_destroy(pp->pp_writecv);
+	}
+	if (pp->pp_readcv != NULL) {
+		cv_destroy(pp->pp_readcv);
+	}
+	if (pp->pp_lock != NULL) {
+		lock_destroy(pp->pp_lock);
+	}
+	if (pp->pp_buf != NULL) {
+		kfree(pp->pp_buf);
+	}
+	kfree(pp);
+}
+
+/*
+ * Pipes are not in the namespace, so nothing should ever open one.
+ */
+static
+int
+pipe_open(struct vnode *v, int flags)
+{
+	(void)v;
+	(void)flags;
+	return EINVAL;
+}
+
+static
+int
+pipe_close(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+/*
+ * Called when an end's last reference goes away. Mark that end closed
+ * and wake whoever is waiting on the other end, so they see EOF or
+ * EPIPE. The pipe itself goes away with the second end.
+ *
+ * VOP_RECLAIM is called with the VFS big lock held, so the two ends'
+ * reclaims never overlap, and the second one can destroy the lock
+ * without racing the first one's lock_release.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe *pp = v->vn_data;
+	bool last;
+
+	lock_acquire(pp->pp_lock);
+	if (v == &pp->pp_readvn) {
+		pp->pp_readopen = false;
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+		pollq_wake(&pp->pp_writepq);
+	}
+	else {
+		KASSERT(v == &pp->pp_writevn);
+		pp->pp_writeopen = false;
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+		pollq_wake(&pp->pp_readpq);
+	}
+	VOP_CLEANUP(v);
+	last = !pp->pp_readopen && !pp->pp_writeopen;
+	lock_release(pp->pp_lock);
+
+	if (last) {
+		pipe_destroy(pp);
+	}
+	return 0;
+}
+
+/*
+ * Read whatever is available, up to the request size, waiting only if
+ * there is nothing at all. Returns with nothing read (EOF) once the
+ * pipe is empty and the write end is closed.
+ */
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe *pp = v->vn_data;
+	unsigned len, chunk;
+	int result = 0;
+
+	KASSERT(uio->uio_rw == UIO_READ);
+	if (v != &pp->pp_readvn) {
+		return EBADF;
+	}
+	if (uio->uio_resid == 0) {
+		return 0;
+	}
+
+	lock_acquire(pp->pp_lock);
+	while (pp->pp_count == 0 && pp->pp_writeopen) {
+		kstat_inc(&ks_sleeps);
+		cv_wait(pp->pp_readcv, pp->pp_lock);
+	}
+
+	len = pp->pp_count;
+	if (len > uio->uio_resid) {
+		len = uio->uio_resid;
+	}
+	while (len > 0) {
+		/* up to the end of the buffer, then wrap */
+		chunk = PIPE_SIZE - pp->pp_head;
+		if (chunk > len) {
+			chunk = len;
+		}
+		result = uiomove(pp->pp_buf + pp->pp_head, chunk, uio);
+		if (result) {
+			break;
+		}
+		pp->pp_head = (pp->pp_head + chunk) % PIPE_SIZE;
+		pp->pp_count -= chunk;
+		len -= chunk;
+		kstat_add(&ks_bytes, chunk);
+	}
+
+	if (pp->pp_writewant > 0 &&
+	    PIPE_SIZE - pp->pp_count >= pp->pp_writewant) {
+		pp->pp_writewant = 0;
+		kstat_inc(&ks_wakeups);
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+		pollq_wake(&pp->pp_writepq);
+	}
+	lock_release(pp->pp_lock);
+	return result;
+}
+
+/*
+ * Write everything, waiting for space as needed. A write of at most
+ * PIPE_BUF bytes waits until it fits in one piece, so it is never
+ * interleaved with other writers' data. If the read end closes part
+ * way through, return the short count; fail with EPIPE only if
+ * nothing was written.
+ */
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe *pp = v->vn_data;
+	size_t start = uio->uio_resid;
+	bool atomic = uio->uio_resid <= PIPE_BUF;
+	unsigned need, len, tail, chunk;
+	bool wasempty;
+	int result = 0;
+
+	KASSERT(uio->uio_rw == UIO_WRITE);
+	if (v != &pp->pp_writevn) {
+		return EBADF;
+	}
+
+	lock_acquire(pp->pp_lock);
+	while (uio->uio_resid > 0) {
+		need = atomic ? uio->uio_resid : 1;
+		while (pp->pp_readopen && PIPE_SIZE - pp->pp_count < need) {
+			if (pp->pp_writewant == 0 || need < pp->pp_writewant) {
+				pp->pp_writewant = need;
+			}
+			kstat_inc(&ks_sleeps);
+			cv_wait(pp->pp_writecv, pp->pp_lock);
+		}
+		if (!pp->pp_readopen) {
+			result = EPIPE;
+			break;
+		}
+
+		wasempty = (pp->pp_count == 0);
+		len = PIPE_SIZE - pp->pp_count;
+		if (len > uio->uio_resid) {
+			len = uio->uio_resid;
+		}
+		while (len > 0) {
+			tail = (pp->pp_head + pp->pp_count) % PIPE_SIZE;
+			chunk = PIPE_SIZE - tail;
+			if (chunk > len) {
+				chunk = len;
+			}
+			result = uiomove(pp->pp_buf + tail, chunk, uio);
+			if (result) {
+				break;
+			}
+			pp->pp_count += chunk;
+			len -= chunk;
+		}
+
+		if (wasempty && pp->pp_count > 0) {
+			kstat_inc(&ks_wakeups);
+			cv_broadcast(pp->pp_readcv, pp->pp_lock);
+			pollq_wake(&pp->pp_readpq);
+		}
+		if (result) {
+			break;
+		}
+	}
+	lock_release(pp->pp_lock);
+
+	if (result == EPIPE && uio->uio_resid < start) {
+		result = 0;
+	}
+	return result;
+}
+
+/*
+ * Used for several functions with the same type signature that are
+ * not meaningful on pipes.
+ */
+static
+int
+pipe_nullio(struct vnode *v, struct uio *uio)
+{
+	(void)v;
+	(void)uio;
+	return EINVAL;
+}
+
+/*
+ * The read end is readable when there is data, the write end writable
+ * when PIPE_BUF bytes would fit. Checked and registered under pp_lock,
+ * which is also held for every pollq_wake, so no wakeup is lost.
+ */
+static
+int
+pipe_poll(struct vnode *v, int events, int *revents, struct pollwaiter *pw)
+{
+	struct pipe *pp = v->vn_data;
+	int result = 0;
+
+	*revents = 0;
+	lock_acquire(pp->pp_lock);
+	if (v == &pp->pp_readvn) {
+		if ((events & POLLIN) && pp->pp_count > 0) {
+			*revents |= POLLIN;
+		}
+		if (!pp->pp_writeopen) {
+			*revents |= POLLHUP;
+		}
+		if (*revents == 0 && (events & POLLIN) && pw != NULL) {
+			result = pollq_add(&pp->pp_readpq, pw);
+		}
+	}
+	else {
+		if ((events & POLLOUT) && PIPE_SIZE - pp->pp_count >= PIPE_BUF) {
+			*revents |= POLLOUT;
+		}
+		if (!pp->pp_readopen) {
+			*revents |= POLLERR;
+		}
+		if (*revents == 0 && (events & POLLOUT) && pw != NULL) {
+			result = pollq_add(&pp->pp_writepq, pw);
+			if (result == 0 && (pp->pp_writewant == 0 ||
+					    pp->pp_writewant > PIPE_BUF)) {
+				pp->pp_writewant = PIPE_BUF;
+			}
+		}
+	}
+	lock_release(pp->pp_lock);
+	return result;
+}
+
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+/*
+ * st_size is the number of bytes waiting to be read.
+ */
+static
+int
+pipe_stat(struct vnode *v, struct stat *statbuf)
+{
+	struct pipe *pp = v->vn_data;
+
+	bzero(statbuf, sizeof(struct stat));
+	statbuf->st_mode = S_IFIFO;
+	statbuf->st_nlink = 1;
+	statbuf->st_size = pp->pp_count;
+	statbuf->st_blksize = PIPE_BUF;
+	return 0;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, mode_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+int
+pipe_tryseek(struct vnode *v, off_t pos)
+{
+	(void)v;
+	(void)pos;
+	return ESPIPE;
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+static
+int
+pipe_mmap(struct vnode *v)
+{
+	(void)v;
+	return EUNIMP;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+/*
+ * Directory operations, none of which apply.
+ */
+
+static
+int
+pipe_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
+	   struct vnode **result)
+{
+	(void)v;
+	(void)name;
+	(void)excl;
+	(void)mode;
+	(void)result;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_symlink(struct vnode *v, const char *contents, const char *name)
+{
+	(void)v;
+	(void)contents;
+	(void)name;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_mkdir(struct vnode *v, const char *name, mode_t mode)
+{
+	(void)v;
+	(void)name;
+	(void)mode;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_link(struct vnode *v, const char *name, struct vnode *file)
+{
+	(void)v;
+	(void)name;
+	(void)file;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_nameop(struct vnode *v, const char *name)
+{
+	(void)v;
+	(void)name;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_rename(struct vnode *v, const char *n1, struct vnode *v2, const char *n2)
+{
+	(void)v;
+	(void)n1;
+	(void)v2;
+	(void)n2;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_lookup(struct vnode *v, char *pathname, struct vnode **result)
+{
+	(void)v;
+	(void)pathname;
+	(void)result;
+	return ENOTDIR;
+}
+
+static
+int
+pipe_lookparent(struct vnode *v, char *pathname, struct vnode **result,
+		char *buf, size_t len)
+{
+	(void)v;
+	(void)pathname;
+	(void)result;
+	(void)buf;
+	(void)len;
+	return ENOTDIR;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	VOP_MAGIC,
+
+	pipe_open,
+	pipe_close,
+	pipe_reclaim,
+	pipe_read,
+	pipe_nullio,	/* readlink */
+	pipe_nullio,	/* getdirentry */
+	pipe_write,
+	pipe_ioctl,
+	pipe_poll,
+	pipe_stat,
+	pipe_gettype,
+	pipe_tryseek,
+	pipe_fsync,
+	pipe_mmap,
+	pipe_truncate,
+	pipe_nullio,	/* namefile */
+	pipe_creat,
+	pipe_symlink,
+	pipe_mkdir,
+	pipe_link,
+	pipe_nameop,	/* remove */
+	pipe_nameop,	/* rmdir */
+	pipe_rename,
+	pipe_lookup,
+	pipe_lookparent,
+};
+
+int
+pipe_create(struct vnode **readend, struct vnode **writeend)
+{
+	struct pipe *pp;
+
+	pp = kmalloc(sizeof(*pp));
+	if (pp == NULL) {
+		return ENOMEM;
+	}
+	pollq_init(&pp->pp_readpq);
+	pollq_init(&pp->pp_writepq);
+	pp->pp_buf = kmalloc(PIPE_SIZE);
+	pp->pp_lock = lock_create("pipe");
+	pp->pp_readcv = cv_create("pipe-read");
+	pp->pp_writecv = cv_create("pipe-write");
+	if (pp->pp_buf == NULL || pp->pp_lock == NULL ||
+	    pp->pp_readcv == NULL || pp->pp_writecv == NULL) {
+		pipe_destroy(pp);
+		return ENOMEM;
+	}
+	pp->pp_head = 0;
+	pp->pp_count = 0;
+	pp->pp_writewant = 0;
+	pp->pp_readopen = true;
+	pp->pp_writeopen = true;
+
+	VOP_INIT(&pp->pp_readvn, &pipe_vnode_ops, NULL, pp);
+	VOP_INIT(&pp->pp_writevn, &pipe_vnode_ops, NULL, pp);
+
+	/* hand them back as if opened with vfs_open */
+	VOP_INCOPEN(&pp->pp_readvn);
+	VOP_INCOPEN(&pp->pp_writevn);
+
+	*readend = &pp->pp_readvn;
+	*writeend = &pp->pp_writevn;
+	return 0;
+}
@@ -160,9 +160,9 @@ vfs_getcwd(struct uio *uio)
 
 	name = FSOP_GETVOLNAME(cwd->vn_fs);
 	if (name==NULL) {
-		vfs_biglock_acquire();
+		vfs_devlock_acquire_read();
 		name = vfs_getdevname(cwd->vn_fs);
-		vfs_biglock_release();
+		vfs_devlock_release_read();
 	}
 	KASSERT(name != NULL);
 
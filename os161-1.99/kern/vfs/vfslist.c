@@ -43,6 +43,7 @@
 #include <fs.h>
 #include <vnode.h>
 #include <device.h>
+#include <addrspace.h>
 
 /*
  * Structure for a single named device.
@@ -91,6 +92,9 @@ static struct knowndevarray *knowndevs;
 static struct lock *vfs_biglock;
 static unsigned vfs_biglock_depth;
 
+/* Shared/exclusive lock for knowndevs and the bootfs vnode. */
+static struct rwlock *vfs_devlock;
+
 
 /*
  * Setup function
@@ -109,7 +113,13 @@ vfs_bootstrap(void)
 	}
 	vfs_biglock_depth = 0;
 
+	vfs_devlock = rwlock_create("vfs_devlock");
+	if (vfs_devlock==NULL) {
+		panic("vfs: Could not create vfs device table lock\n");
+	}
+
 	devnull_create();
+	devkstat_create();
 }
 
 /*
@@ -145,6 +155,43 @@ vfs_biglock_do_i_hold(void)
 	return lock_do_i_hold(vfs_biglock);
 }
 
+/*
+ * Operations on vfs_devlock. This covers only the device table and
+ * the bootfs vnode, which nearly every path lookup reads and almost
+ * nothing ever changes, so lookups can proceed in parallel. Unlike
+ * vfs_biglock it is not recursive. If both are needed, vfs_devlock
+ * must be taken first.
+ */
+void
+vfs_devlock_acquire_read(void)
+{
+	rwlock_acquire_read(vfs_devlock);
+}
+
+void
+vfs_devlock_release_read(void)
+{
+	rwlock_release_read(vfs_devlock);
+}
+
+void
+vfs_devlock_acquire_write(void)
+{
+	rwlock_acquire_write(vfs_devlock);
+}
+
+void
+vfs_devlock_release_write(void)
+{
+	rwlock_release_write(vfs_devlock);
+}
+
+bool
+vfs_devlock_is_held(void)
+{
+	return rwlock_is_held(vfs_devlock);
+}
+
 /*
  * Global sync function - call FSOP_SYNC on all devices.
  */
@@ -154,7 +201,7 @@ vfs_sync(void)
 	struct knowndev *dev;
 	unsigned i, num;
 
-	vfs_biglock_acquire();
+	vfs_devlock_acquire_read();
 
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
@@ -164,14 +211,14 @@ vfs_sync(void)
 		}
 	}
 
-	vfs_biglock_release();
+	vfs_devlock_release_read();
 
 	return 0;
 }
 
 /*
  * Given a device name (lhd0, emu0, somevolname, null, etc.), hand
- * back an appropriate vnode.
+ * back an appropriate vnode. The caller should hold vfs_devlock.
  */
 int
 vfs_getroot(const char *devname, struct vnode **result)
@@ -179,7 +226,7 @@ vfs_getroot(const char *devname, struct vnode **result)
 	struct knowndev *kd;
 	unsigned i, num;
 
-	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(vfs_devlock_is_held());
 
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
@@ -252,6 +299,7 @@ vfs_getroot(const char *devname, struct vnode **result)
 
 /*
  * Given a filesystem, hand back the name of the device it's mounted on.
+ * The caller should hold vfs_devlock.
  */
 const char *
 vfs_getdevname(struct fs *fs)
@@ -261,7 +309,7 @@ vfs_getdevname(struct fs *fs)
 
 	KASSERT(fs != NULL);
 
-	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(vfs_devlock_is_held());
 
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
@@ -338,7 +386,7 @@ badnames(const char *n1, const char *n2, const char *n3)
 	unsigned i, num;
 	struct knowndev *kd;
 
-	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(rwlock_do_i_hold_write(vfs_devlock));
 
 	num = knowndevarray_num(knowndevs);
 	for (i=0; i<num; i++) {
@@ -378,7 +426,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 	unsigned index;
 	int result;
 
-	vfs_biglock_acquire();
+	vfs_devlock_acquire_write();
 
 	name = kstrdup(dname);
 	if (name==NULL) {
@@ -412,7 +460,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 	}
 
 	if (badnames(name, rawname, volname)) {
-		vfs_biglock_release();
+		vfs_devlock_release_write();
 		return EEXIST;
 	}
 
@@ -423,7 +471,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 		dev->d_devnumber = index+1;
 	}
 
-	vfs_biglock_release();
+	vfs_devlock_release_write();
 	return result;
 
  nomem:
@@ -441,7 +489,7 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 		kfree(kd);
 	}
 	
-	vfs_biglock_release();
+	vfs_devlock_release_write();
 	return ENOMEM;
 }
 
@@ -470,7 +518,7 @@ vfs_addfs(const char *devname, struct fs *fs)
 
 /*
  * Look for a mountable device named DEVNAME.
- * Should already hold knowndevs_lock.
+ * Should already hold vfs_devlock exclusive.
  */
 static
 int
@@ -480,7 +528,7 @@ findmount(const char *devname, struct knowndev **result)
 	unsigned i, num;
 	bool found = false;
 
-	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(rwlock_do_i_hold_write(vfs_devlock));
 
 	num = knowndevarray_num(knowndevs);
 	for (i=0; !found && i<num; i++) {
@@ -514,16 +562,19 @@ vfs_mount(const char *devname, void *data,
 	struct fs *fs;
 	int result;
 
+	vfs_devlock_acquire_write();
 	vfs_biglock_acquire();
 
 	result = findmount(devname, &kd);
 	if (result) {
 		vfs_biglock_release();
+		vfs_devlock_release_write();
 		return result;
 	}
 
 	if (kd->kd_fs != NULL) {
 		vfs_biglock_release();
+		vfs_devlock_release_write();
 		return EBUSY;
 	}
 	KASSERT(kd->kd_rawname != NULL);
@@ -532,6 +583,7 @@ vfs_mount(const char *devname, void *data,
 	result = mountfunc(data, kd->kd_device, &fs);
 	if (result) {
 		vfs_biglock_release();
+		vfs_devlock_release_write();
 		return result;
 	}
 
@@ -544,6 +596,7 @@ vfs_mount(const char *devname, void *data,
 		volname ? volname : kd->kd_name, kd->kd_name);
 
 	vfs_biglock_release();
+	vfs_devlock_release_write();
 	return 0;
 }
 
@@ -557,6 +610,10 @@ vfs_unmount(const char *devname)
 	struct knowndev *kd;
 	int result;
 
+	/* cached executables would keep the filesystem busy */
+	execcache_flush(NULL);
+
+	vfs_devlock_acquire_write();
 	vfs_biglock_acquire();
 
 	result = findmount(devname, &kd);
@@ -590,6 +647,7 @@ vfs_unmount(const char *devname)
 
  fail:
 	vfs_biglock_release();
+	vfs_devlock_release_write();
 	return result;
 }
 
@@ -603,6 +661,9 @@ vfs_unmountall(void)
 	unsigned i, num;
 	int result;
 
+	execcache_flush(NULL);
+
+	vfs_devlock_acquire_write();
 	vfs_biglock_acquire();
 
 	num = knowndevarray_num(knowndevs);
@@ -651,6 +712,7 @@ vfs_unmountall(void)
 	}
 
 	vfs_biglock_release();
+	vfs_devlock_release_write();
 
 	return 0;
 }
@@ -75,14 +75,11 @@ vfs_setbootfs(const char *fsname)
 	int result;
 	struct vnode *newguy;
 
-	vfs_biglock_acquire();
-
 	snprintf(tmp, sizeof(tmp)-1, "%s", fsname);
 	s = strchr(tmp, ':');
 	if (s) {
 		/* If there's a colon, it must be at the end */
 		if (strlen(s)>0) {
-			vfs_biglock_release();
 			return EINVAL;
 		}
 	}
@@ -92,19 +89,17 @@ vfs_setbootfs(const char *fsname)
 
 	result = vfs_chdir(tmp);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	result = vfs_getcurdir(&newguy);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
+	vfs_devlock_acquire_write();
 	change_bootfs(newguy);
-
-	vfs_biglock_release();
+	vfs_devlock_release_write();
 	return 0;
 }
 
@@ -114,15 +109,19 @@ vfs_setbootfs(const char *fsname)
 void
 vfs_clearbootfs(void)
 {
-	vfs_biglock_acquire();
+	vfs_devlock_acquire_write();
 	change_bootfs(NULL);
-	vfs_biglock_release();
+	vfs_devlock_release_write();
 }
 
 
 /*
  * Common code to pull the device name, if any, off the front of a
  * path and choose the vnode to begin the name lookup relative to.
+ *
+ * This only needs to look at the device table and bootfs_vnode, so
+ * it runs under vfs_devlock held shared rather than vfs_biglock;
+ * concurrent lookups do not serialize here.
  */
 
 static
@@ -133,7 +132,7 @@ getdevice(char *path, char **subpath, struct vnode **startvn)
 	struct vnode *vn;
 	int result;
 
-	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(vfs_devlock_is_held());
 
 	/*
 	 * Locate the first colon or slash.
@@ -235,11 +234,10 @@ vfs_lookparent(char *path, struct vnode **retval,
 	struct vnode *startvn;
 	int result;
 
-	vfs_biglock_acquire();
-
+	vfs_devlock_acquire_read();
 	result = getdevice(path, &path, &startvn);
+	vfs_devlock_release_read();
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
@@ -257,7 +255,6 @@ vfs_lookparent(char *path, struct vnode **retval,
 
 	VOP_DECREF(startvn);
 
-	vfs_biglock_release();
 	return result;
 }
 
@@ -267,23 +264,20 @@ vfs_lookup(char *path, struct vnode **retval)
 	struct vnode *startvn;
 	int result;
 
-	vfs_biglock_acquire();
-
+	vfs_devlock_acquire_read();
 	result = getdevice(path, &path, &startvn);
+	vfs_devlock_release_read();
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	if (strlen(path)==0) {
 		*retval = startvn;
-		vfs_biglock_release();
 		return 0;
 	}
 
 	result = VOP_LOOKUP(startvn, path, retval);
 
 	VOP_DECREF(startvn);
-	vfs_biglock_release();
 	return result;
 }
@@ -32,6 +32,7 @@
  */
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <lib.h>
 #include <synch.h>
 #include <vfs.h>
@@ -51,6 +52,7 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 	vn->vn_ops = ops;
 	vn->vn_refcount = 1;
 	vn->vn_opencount = 0;
+	vn->vn_gen = 0;
 	vn->vn_fs = fs;
 	vn->vn_data = fsdata;
 	return 0;
@@ -166,6 +168,32 @@ vnode_decopen(struct vnode *vn)
 	vfs_biglock_release();
 }
 
+/*
+ * Note a completed write or truncate. Bumping after the operation
+ * (whether or not it succeeded) means anyone who sampled vn_gen before
+ * reading contents that the operation may have changed will see a
+ * different value afterwards.
+ */
+int
+vnode_modified(struct vnode *vn, int result)
+{
+	vn->vn_gen++;
+	return result;
+}
+
+/*
+ * Generic VOP_POLL for objects that never block.
+ */
+int
+vnode_pollready(struct vnode *vn, int events, int *revents,
+		struct pollwaiter *pw)
+{
+	(void)vn;
+	(void)pw;
+	*revents = events & (POLLIN | POLLOUT);
+	return 0;
+}
+
 /*
  * Check for various things being valid.
  * Called before all VOP_* calls.
@@ -0,0 +1,54 @@
+/*
+ * The kernel data page shared by every process. See <kern/kdata.h>.
+ *
+ * Only timerclock writes it, on one CPU, so the sequence count needs
+ * no lock of its own. The per-process page belongs to the VM system,
+ * which keeps its pid up to date in as_activate.
+ */
+#include <types.h>
+#include <kern/kdata.h>
+#include <lib.h>
+#include <clock.h>
+#include <vm.h>
+#include <kdata.h>
+
+static struct kdata_sys *kdata_sys;
+
+void
+kdata_bootstrap(void)
+{
+	vaddr_t page;
+
+	page = alloc_kpages(1);
+	if (page == 0) {
+		panic("kdata_bootstrap: Out of memory\n");
+	}
+	bzero((void *)page, PAGE_SIZE);
+	kdata_sys = (struct kdata_sys *)page;
+	kdata_timerclock();
+}
+
+paddr_t
+kdata_syspage(void)
+{
+	KASSERT(kdata_sys != NULL);
+	return KVADDR_TO_PADDR((vaddr_t)kdata_sys);
+}
+
+void
+kdata_timerclock(void)
+{
+	time_t sec;
+	uint32_t nsec;
+
+	/* the timer runs before we're set up */
+	if (kdata_sys == NULL) {
+		return;
+	}
+
+	gettime(&sec, &nsec);
+	kdata_sys->kd_seq++;
+	kdata_sys->kd_sec = sec;
+	kdata_sys->kd_nsec = nsec;
+	kdata_sys->kd_seq++;
+}
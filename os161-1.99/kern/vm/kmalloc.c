@@ -193,9 +193,12 @@ static struct pageref *allbase;
  * logic per-cpu is worthwhile for scalability; however, for the time
  * being at least we won't, because it adds a lot of complexity and in
  * OS/161 performance and scalability aren't super-critical.
+ *
+ * It is a queued spinlock, since every cpu hits it and it is the
+ * most contended spinlock in the system.
  */
 
-static struct spinlock kmalloc_spinlock = SPINLOCK_INITIALIZER;
+static struct spinlock kmalloc_spinlock = SPINLOCK_QUEUED_INITIALIZER;
 
 ////////////////////////////////////////
 
@@ -347,6 +350,28 @@ kheap_printstats(void)
 	spinlock_release(&kmalloc_spinlock);
 }
 
+/*
+ * Return the number of bytes of subpage blocks currently allocated.
+ * (Large allocations go straight to alloc_kpages and aren't counted.)
+ */
+size_t
+kheap_getused(void)
+{
+	struct pageref *pr;
+	size_t used = 0;
+	unsigned blktype;
+
+	spinlock_acquire(&kmalloc_spinlock);
+	for (pr = allbase; pr != NULL; pr = pr->next_all) {
+		blktype = PR_BLOCKTYPE(pr);
+		used += (PAGE_SIZE / sizes[blktype] - pr->nfree) *
+			sizes[blktype];
+	}
+	spinlock_release(&kmalloc_spinlock);
+
+	return used;
+}
+
 ////////////////////////////////////////
 
 static
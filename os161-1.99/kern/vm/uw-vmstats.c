@@ -2,24 +2,29 @@
 
 /* belongs in kern/vm/uw-vmstats.c */
 
-/* NOTE !!!!!! WARNING !!!!!
- * All of the functions whose names begin with '_'
- * assume that atomicity is ensured elsewhere
- * (i.e., outside of these routines) by acquiring stats_lock.
- * All of the functions whose names do not begin
- * with '_' ensure atomicity locally.
+/* NOTE: the counters are per-cpu kstats (see <kstat.h>), so incrementing
+ * them needs no lock. The functions whose names begin with '_' are
+ * kept for compatibility and are now the same as the ones without.
  */
 
 #include <types.h>
 #include <lib.h>
-#include <synch.h>
-#include <spl.h>
+#include <kstat.h>
 #include <uw-vmstats.h>
 
-/* Counters for tracking statistics */
-static unsigned int stats_counts[VMSTAT_COUNT];
-
-struct spinlock stats_lock = SPINLOCK_INITIALIZER;
+/* Counters for tracking statistics; also readable through kstat */
+static struct kstat stats_counts[VMSTAT_COUNT] = {
+ /*  0 */ KSTAT_COUNTER("vm.tlb_faults"),
+ /*  1 */ KSTAT_COUNTER("vm.tlb_faults_free"),
+ /*  2 */ KSTAT_COUNTER("vm.tlb_faults_replace"),
+ /*  3 */ KSTAT_COUNTER("vm.tlb_invalidations"),
+ /*  4 */ KSTAT_COUNTER("vm.tlb_reloads"),
+ /*  5 */ KSTAT_COUNTER("vm.page_faults_zeroed"),
+ /*  6 */ KSTAT_COUNTER("vm.page_faults_disk"),
+ /*  7 */ KSTAT_COUNTER("vm.page_faults_elf"),
+ /*  8 */ KSTAT_COUNTER("vm.page_faults_swapfile"),
+ /*  9 */ KSTAT_COUNTER("vm.swapfile_writes"),
+};
 
 /* Strings used in printing out the statistics */
 static const char *stats_names[] = {
@@ -41,23 +46,14 @@ static const char *stats_names[] = {
 void
 vmstats_inc(unsigned int index)
 {
-    spinlock_acquire(&stats_lock);
-      _vmstats_inc(index);
-    spinlock_release(&stats_lock);
+  _vmstats_inc(index);
 }
 
 /* ---------------------------------------------------------------------- */
 void
 vmstats_init(void)
 {
-  /* Although the spinlock is initialized at declaration time we do it here
-   * again in case we want use/reset these stats repeatedly without shutting down the kernel.
-   */
-  spinlock_init(&stats_lock);
-
-  spinlock_acquire(&stats_lock);
-    _vmstats_init();
-  spinlock_release(&stats_lock);
+  _vmstats_init();
 }
 
 /* ---------------------------------------------------------------------- */
@@ -65,7 +61,7 @@ void
 _vmstats_inc(unsigned int index)
 {
   KASSERT(index < VMSTAT_COUNT);
-  stats_counts[index]++;
+  kstat_inc(&stats_counts[index]);
 }
 
 /* ---------------------------------------------------------------------- */
@@ -81,21 +77,22 @@ _vmstats_init(void)
   }
 
   for (i=0; i<VMSTAT_COUNT; i++) {
-    stats_counts[i] = 0;
+    percpu_counter_reset(&stats_counts[i].ks_value);
+    kstat_register(&stats_counts[i]);
   }
 
 }
 
 /* ---------------------------------------------------------------------- */
 /* Assumes vmstat_init has already been called */
-/* NOTE: We do not grab the spinlock here because kprintf may block
- * and we can't block while holding a spinlock.
- * Just use this when there is only one thread remaining.
+/* NOTE: The counts are read without stopping other cpus, so the totals
+ * are only consistent with each other when there is one thread remaining.
  */
 
 void
 vmstats_print(void)
 {
+  unsigned int counts[VMSTAT_COUNT];
   int i = 0;
   int free_plus_replace = 0;
   int disk_plus_zeroed_plus_reload = 0;
@@ -103,17 +100,21 @@ vmstats_print(void)
   int elf_plus_swap_reads = 0;
   int disk_reads = 0;
 
+  for (i=0; i<VMSTAT_COUNT; i++) {
+    counts[i] = kstat_read(&stats_counts[i]);
+  }
+
   kprintf("VMSTATS:\n");
   for (i=0; i<VMSTAT_COUNT; i++) {
-    kprintf("VMSTAT %25s = %10d\n", stats_names[i], stats_counts[i]);
+    kprintf("VMSTAT %25s = %10d\n", stats_names[i], counts[i]);
   }
 
-  tlb_faults = stats_counts[VMSTAT_TLB_FAULT];
-  free_plus_replace = stats_counts[VMSTAT_TLB_FAULT_FREE] + stats_counts[VMSTAT_TLB_FAULT_REPLACE];
-  disk_plus_zeroed_plus_reload = stats_counts[VMSTAT_PAGE_FAULT_DISK] +
-    stats_counts[VMSTAT_PAGE_FAULT_ZERO] + stats_counts[VMSTAT_TLB_RELOAD];
-  elf_plus_swap_reads = stats_counts[VMSTAT_ELF_FILE_READ] + stats_counts[VMSTAT_SWAP_FILE_READ];
-  disk_reads = stats_counts[VMSTAT_PAGE_FAULT_DISK];
+  tlb_faults = counts[VMSTAT_TLB_FAULT];
+  free_plus_replace = counts[VMSTAT_TLB_FAULT_FREE] + counts[VMSTAT_TLB_FAULT_REPLACE];
+  disk_plus_zeroed_plus_reload = counts[VMSTAT_PAGE_FAULT_DISK] +
+    counts[VMSTAT_PAGE_FAULT_ZERO] + counts[VMSTAT_TLB_RELOAD];
+  elf_plus_swap_reads = counts[VMSTAT_ELF_FILE_READ] + counts[VMSTAT_SWAP_FILE_READ];
+  disk_reads = counts[VMSTAT_PAGE_FAULT_DISK];
 
   kprintf("VMSTAT TLB Faults with Free + TLB Faults with Replace = %d\n", free_plus_replace);
   if (tlb_faults != free_plus_replace) {
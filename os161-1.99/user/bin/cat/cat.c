@@ -36,6 +36,9 @@
  * Usage: cat [files]
  */
 
+/* Most we ask fdcopy for at once; in practice, the whole file. */
+#define COPY_MAX 0x7fffffff
+
 
 
 /* Print a file that's already been opened. */
@@ -43,31 +46,19 @@ static
 void
 docat(const char *name, int fd)
 {
-	char buf[1024];
-	int len, wr, wrtot;
+	int len;
 
 	/*
-	 * As long as we get more than zero bytes, we haven't hit EOF.
-	 * Zero means EOF. Less than zero means an error occurred.
-	 * We may read less than we asked for, though, in various cases
-	 * for various reasons.
+	 * fdcopy moves the data to stdout inside the kernel. It returns
+	 * zero at EOF and less than zero on error. It may copy less than
+	 * we asked for (from the console, a line at a time), so keep
+	 * going until it copies nothing.
 	 */
-	while ((len = read(fd, buf, sizeof(buf)))>0) {
-		/*
-		 * Likewise, we may actually write less than we attempted
-		 * to. So loop until we're done.
-		 */
-		wrtot = 0;
-		while (wrtot < len) {
-			wr = write(STDOUT_FILENO, buf+wrtot, len-wrtot);
-			if (wr<0) {
-				err(1, "stdout");
-			}
-			wrtot += wr;
-		}
+	while ((len = fdcopy(fd, STDOUT_FILENO, COPY_MAX))>0) {
+		/* nothing */
 	}
 	/*
-	 * If we got a read error, print it and exit.
+	 * If we got an error, print it and exit.
 	 */
 	if (len<0) {
 		err(1, "%s", name);
@@ -35,6 +35,9 @@
  * Usage: cp oldfile newfile
  */
 
+/* Most we ask fdcopy for at once; in practice, the whole file. */
+#define COPY_MAX 0x7fffffff
+
 
 /* Copy one file to another. */
 static
@@ -43,8 +46,7 @@ copy(const char *from, const char *to)
 {
 	int fromfd;
 	int tofd;
-	char buf[1024];
-	int len, wr, wrtot;
+	int len;
 
 	/*
 	 * Open the files, and give up if they won't open
@@ -59,30 +61,16 @@ copy(const char *from, const char *to)
 	}
 
 	/*
-	 * As long as we get more than zero bytes, we haven't hit EOF.
-	 * Zero means EOF. Less than zero means an error occurred.
-	 * We may read less than we asked for, though, in various cases
-	 * for various reasons.
+	 * fdcopy moves the data inside the kernel, without bringing it
+	 * out to us and handing it back. It returns zero at EOF and less
+	 * than zero on error; it may copy less than we asked for, so
+	 * keep going until it copies nothing.
 	 */
-	while ((len = read(fromfd, buf, sizeof(buf)))>0) {
-		/*
-		 * Likewise, we may actually write less than we attempted
-		 * to. So loop until we're done.
-		 */
-		wrtot = 0;
-		while (wrtot < len) {
-			wr = write(tofd, buf+wrtot, len-wrtot);
-			if (wr<0) {
-				err(1, "%s", to);
-			}
-			wrtot += wr;
-		}
+	while ((len = fdcopy(fromfd, tofd, COPY_MAX)) > 0) {
+		/* nothing */
 	}
-	/*
-	 * If we got a read error, print it and exit.
-	 */
 	if (len<0) {
-		err(1, "%s", from);
+		err(1, "%s to %s", from, to);
 	}
 
 	if (close(fromfd) < 0) {
@@ -32,8 +32,10 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <err.h>
+#include <kern/syscall.h>
 
 /*
  * ls - list files.
@@ -45,6 +47,17 @@
  *    -s   (with -l) Show block counts.
  */
 
+/*
+ * Directory entries are read, and stat'd if need be, NBATCH at a time
+ * with one multicall each, rather than one to three system calls per
+ * entry. listdir doesn't recurse, so these can be static.
+ */
+#define NBATCH 16
+static char names[NBATCH][NAME_MAX+1];
+static char paths[NBATCH][PATH_MAX];
+static struct stat stats[NBATCH];
+static struct multicall calls[NBATCH];
+
 /* Flags for which options we're using. */
 static int aopt=0;
 static int dopt=0;
@@ -127,18 +140,22 @@ printheader(const char *file)
 }
 
 /*
- * Show a single file.
+ * Show a single file. STATP, if not NULL, is its stat info; otherwise
+ * it's looked up here if needed.
  * We don't do the neat multicolumn listing that Unix ls does.
  */
 static
 void
-print(const char *path)
+print(const char *path, const struct stat *statp)
 {
 	struct stat statbuf;
 	const char *file;
 	int typech;
 
-	if (lopt || sopt) {
+	if (statp != NULL) {
+		statbuf = *statp;
+	}
+	else if (lopt || sopt) {
 		int fd;
 
 		fd = open(path, O_RDONLY);
@@ -185,6 +202,61 @@ print(const char *path)
 	printf("%s\n", file);
 }
 
+/*
+ * Read up to NBATCH entries of directory FD (named PATH) into names[],
+ * and their full pathnames into paths[]. If WANTSTAT, stat them all
+ * into stats[] too. Returns how many; 0 at the end of the directory.
+ */
+static
+int
+readbatch(int fd, const char *path, int wantstat)
+{
+	int i, n;
+
+	for (i=0; i<NBATCH; i++) {
+		calls[i].mc_callno = SYS_getdirentry;
+		calls[i].mc_args[0] = fd;
+		calls[i].mc_args[1] = (unsigned long)names[i];
+		calls[i].mc_args[2] = sizeof(names[i])-1;
+	}
+	n = multicall(calls, NBATCH, MC_STOPONERR);
+	if (n<0) {
+		err(1, "%s: multicall", path);
+	}
+	for (i=0; i<n; i++) {
+		if (calls[i].mc_err) {
+			errno = calls[i].mc_err;
+			err(1, "%s: getdirentry", path);
+		}
+		if (calls[i].mc_retval == 0) {
+			/* end of directory; the rest got 0 too */
+			break;
+		}
+		names[i][calls[i].mc_retval] = 0;
+
+		/* Assemble the full name of the new item */
+		snprintf(paths[i], sizeof(paths[i]), "%s/%s", path, names[i]);
+	}
+	n = i;
+
+	if (wantstat && n > 0) {
+		for (i=0; i<n; i++) {
+			calls[i].mc_callno = SYS_stat;
+			calls[i].mc_args[0] = (unsigned long)paths[i];
+			calls[i].mc_args[1] = (unsigned long)&stats[i];
+		}
+		i = multicall(calls, n, MC_STOPONERR);
+		if (i<0) {
+			err(1, "%s: multicall", path);
+		}
+		if (i>0 && calls[i-1].mc_err) {
+			errno = calls[i-1].mc_err;
+			err(1, "%s: stat", paths[i-1]);
+		}
+	}
+	return n;
+}
+
 /*
  * List a directory.
  */
@@ -193,9 +265,7 @@ void
 listdir(const char *path, int showheader)
 {
 	int fd;
-	char buf[1024];
-	char newpath[1024];
-	int len;
+	int i, n;
 
 	if (showheader) {
 		printheader(path);
@@ -212,20 +282,14 @@ listdir(const char *path, int showheader)
 	/*
 	 * List the directory.
 	 */
-	while ((len = getdirentry(fd, buf, sizeof(buf)-1)) > 0) {
-		buf[len] = 0;
-
-		/* Assemble the full name of the new item */
-		snprintf(newpath, sizeof(newpath), "%s/%s", path, buf);
-
-		if (aopt || buf[0]!='.') {
-			/* Print it */
-			print(newpath);
+	while ((n = readbatch(fd, path, lopt || sopt)) > 0) {
+		for (i=0; i<n; i++) {
+			if (aopt || names[i][0]!='.') {
+				/* Print it */
+				print(paths[i], (lopt || sopt) ? &stats[i] : NULL);
+			}
 		}
 	}
-	if (len<0) {
-		err(1, "%s: getdirentry", path);
-	}
 
 	/* Done */
 	close(fd);
@@ -294,7 +358,7 @@ listitem(const char *path, int showheader)
 		}
 	}
 	else {
-		print(path);
+		print(path, NULL);
 	}
 }
 
@@ -292,12 +292,131 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * startstage
+ * starts one command of a pipeline with its stdin and stdout replaced
+ * by infd and outfd (where those aren't -1). closefd, if not -1, is
+ * the read end of the stage's own output pipe, which the stage must
+ * not hold: if it did, a writer whose reader quit would block once the
+ * pipe filled instead of getting EPIPE, and we would wait on it
+ * forever. returns the pid, or -1.
+ */
+static
+pid_t
+startstage(char **args, int infd, int outfd, int closefd)
+{
+	pid_t pid;
+
+#ifdef HOST
+	pid = fork();
+#else
+	/*
+	 * spawn() can't close descriptors in the child, so use vfork;
+	 * the child only shuffles descriptors and execs, so it can
+	 * borrow our address space for that.
+	 */
+	pid = vfork();
+#endif
+	if (pid < 0) {
+		warn("fork");
+		return -1;
+	}
+	if (pid == 0) {
+		if (infd >= 0) {
+			dup2(infd, STDIN_FILENO);
+			close(infd);
+		}
+		if (outfd >= 0) {
+			dup2(outfd, STDOUT_FILENO);
+			close(outfd);
+		}
+		if (closefd >= 0) {
+			close(closefd);
+		}
+		execv(args[0], args);
+		warn("%s", args[0]);
+		_exit(1);
+	}
+	return pid;
+}
+
+/*
+ * dopipeline
+ * runs "cmd | cmd | ...", where args is the whole command line with
+ * the "|" tokens still in it. each command's stdout feeds the next
+ * one's stdin. waits for all of them and returns the status of the
+ * last.
+ *
+ * the write end of each pipe is closed as soon as its writer has been
+ * started, so that later stages don't inherit it and the reader sees
+ * end of file when the writer exits.
+ */
+static
+int
+dopipeline(char **args, int nargs)
+{
+	pid_t pids[NARG_MAX/2 + 1];
+	pid_t lastpid = -1;
+	int npids = 0;
+	int start = 0, infd = -1, i, j, status;
+	int fds[2];
+	int result = _MKWAIT_EXIT(1);
+
+	for (i=0; i<=nargs; i++) {
+		if (i < nargs && strcmp(args[i], "|")) {
+			continue;
+		}
+		if (i == start) {
+			printf("sh: Missing command in pipeline\n");
+			break;
+		}
+		args[i] = NULL;
+
+		fds[0] = fds[1] = -1;
+		if (i < nargs && pipe(fds) < 0) {
+			warn("pipe");
+			break;
+		}
+		lastpid = startstage(&args[start], infd, fds[1], fds[0]);
+		if (lastpid >= 0) {
+			pids[npids++] = lastpid;
+		}
+		if (infd >= 0) {
+			close(infd);
+		}
+		if (fds[1] >= 0) {
+			close(fds[1]);
+		}
+		infd = fds[0];
+		start = i+1;
+	}
+	if (i <= nargs) {
+		/* stopped early; don't run the last command after all */
+		lastpid = -1;
+		if (infd >= 0) {
+			close(infd);
+		}
+	}
+
+	for (j=0; j<npids; j++) {
+		if (waitpid(pids[j], &status, 0) < 0) {
+			warn("waitpid");
+			status = -1;
+		}
+		if (pids[j] == lastpid) {
+			result = status;
+		}
+	}
+	return result;
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
  * simply returns.  checks to see if it's a builtin, running it if it is.
  * otherwise, it's a standard command.  check for the '&', try to background
- * the job if possible, otherwise just run it and wait on it.
+ * the job if possible, otherwise just run it and wait on it.  a line with
+ * "|" tokens in it is a pipeline, handed off to dopipeline.
  */
 static
 int
@@ -350,10 +469,22 @@ docommand(char *buf)
 		bg = 1;
 	}
 
+	for (i=0; i<nargs; i++) {
+		if (!strcmp(args[i], "|")) {
+			if (bg) {
+				printf("%s: Pipelines can't be run in the "
+				       "background\n", args[0]);
+				return 1;
+			}
+			return dopipeline(args, nargs);
+		}
+	}
+
 	if (timing) {
 		__time(&startsecs, &startnsecs);
 	}
 
+#ifdef HOST
 	pid = fork();
 	switch (pid) {
 		case -1:
@@ -375,6 +506,17 @@ docommand(char *buf)
 		default:
 			break;
 	}
+#else
+	/*
+	 * spawn() does the fork and exec in one go, without copying
+	 * our address space only to throw the copy away.
+	 */
+	pid = spawn(args[0], args);
+	if (pid < 0) {
+		warn("%s", args[0]);
+		return _MKWAIT_EXIT(1);
+	}
+#endif
 
 	/* parent */
 	if (bg) {
@@ -39,10 +39,14 @@
  */
 #include <kern/fcntl.h>
 #include <kern/ioctl.h>
+#include <kern/iovec.h>
+#include <kern/multicall.h>
+#include <kern/poll.h>
 #include <kern/reboot.h>
 #include <kern/seek.h>
 #include <kern/time.h>
 #include <kern/unistd.h>
+#include <kern/uring.h>
 #include <kern/wait.h>
 
 
@@ -64,6 +68,8 @@
  *     open:     fcntl.h or sys/fcntl.h
  *     reboot:   sys/reboot.h
  *     ioctl:    sys/ioctl.h
+ *     poll:     poll.h
+ *     readv:    sys/uio.h (also writev, preadv, pwritev)
  *     remove:   stdio.h
  *     rename:   stdio.h
  *     time:     time.h
@@ -146,12 +152,25 @@ int link(const char *oldfile, const char *newfile);
 int chdir(const char *path);
 
 /* Optional. */
+pid_t vfork(void);
+pid_t spawn(const char *prog, char *const *args);
 void *sbrk(int change);
 int getdirentry(int filehandle, char *buf, size_t buflen);
 int symlink(const char *target, const char *linkname);
 int readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
+int pread(int filehandle, void *buf, size_t size, off_t pos);
+int pwrite(int filehandle, const void *buf, size_t size, off_t pos);
+int readv(int filehandle, const struct iovec *iov, int iovcnt);
+int writev(int filehandle, const struct iovec *iov, int iovcnt);
+int preadv(int filehandle, const struct iovec *iov, int iovcnt, off_t pos);
+int pwritev(int filehandle, const struct iovec *iov, int iovcnt, off_t pos);
 int pipe(int filehandles[2]);
+int fdcopy(int infile, int outfile, size_t len);
+int poll(struct pollfd *fds, unsigned nfds, int timeout);
+int uring_setup(struct uring_ring **ring);
+int uring_enter(unsigned to_submit, unsigned min_complete);
+int multicall(struct multicall *calls, unsigned ncalls, int flags);
 time_t __time(time_t *seconds, unsigned long *nanoseconds);
 int __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
@@ -52,7 +52,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <err.h>
+#include <kern/syscall.h>
 
 #define TESTDIR "seektestdir"
 
@@ -124,12 +126,50 @@ closeit(void)
 	dirfd = -1;
 }
 
+/*
+ * Read the next entry into BUF and find out where the one after it
+ * starts, with one multicall instead of getdirentry plus lseek.
+ * Returns what getdirentry did; the new position goes in *NEXTPOS.
+ */
+static
+int
+readandtell(char *buf, size_t buflen, off_t *nextpos)
+{
+	struct multicall mc[2];
+
+	mc[0].mc_callno = SYS_getdirentry;
+	mc[0].mc_args[0] = dirfd;
+	mc[0].mc_args[1] = (unsigned long)buf;
+	mc[0].mc_args[2] = buflen;
+
+	/* lseek(dirfd, 0, SEEK_CUR): the offset takes the a2/a3 pair */
+	mc[1].mc_callno = SYS_lseek;
+	mc[1].mc_args[0] = dirfd;
+	mc[1].mc_args[2] = 0;
+	mc[1].mc_args[3] = 0;
+	mc[1].mc_args[4] = SEEK_CUR;
+
+	if (multicall(mc, 2, MC_STOPONERR) < 0) {
+		err(1, ".: multicall");
+	}
+	if (mc[0].mc_err) {
+		errno = mc[0].mc_err;
+		return -1;
+	}
+	if (mc[1].mc_err) {
+		errno = mc[1].mc_err;
+		err(1, ".: lseek(0, SEEK_CUR)");
+	}
+	*nextpos = mc[1].mc_retval;
+	return mc[0].mc_retval;
+}
+
 static
 void
 readit(void)
 {
 	char buf[4096];
-	off_t pos;
+	off_t pos, nextpos;
 	int len;
 	int n, i, ix;
 
@@ -143,7 +183,7 @@ readit(void)
 	}
 	n = 0;
 
-	while ((len = getdirentry(dirfd, buf, sizeof(buf)-1)) > 0) {
+	while ((len = readandtell(buf, sizeof(buf)-1, &nextpos)) > 0) {
 
 		if ((unsigned)len >= sizeof(buf)-1) {
 			errx(1, ".: entry %d: getdirentry returned "
@@ -162,11 +202,7 @@ readit(void)
 		}
 
 		testfiles[ix].pos = pos;
-		
-		pos = lseek(dirfd, 0, SEEK_CUR);
-		if (pos < 0) {
-			err(1, ".: lseek(0, SEEK_CUR)");
-		}
+		pos = nextpos;
 		n++;
 	}
 	if (len<0) {
@@ -516,18 +552,28 @@ static
 void
 cleanup(void)
 {
-	int i;
+	struct multicall mc[MULTICALL_MAX];
+	int i, n, r;
 
 	printf("Cleaning up...\n");
 
-	/* Remove the files */
+	/* Remove the files, all in one go */
+	n = 0;
 	for (i=0; testfiles[i].name; i++) {
 		if (testfiles[i].make_it) {
-			if (remove(testfiles[i].name)<0) {
-				err(1, "%s: remove", testfiles[i].name);
-			}
+			mc[n].mc_callno = SYS_remove;
+			mc[n].mc_args[0] = (unsigned long)testfiles[i].name;
+			n++;
 		}
 	}
+	r = multicall(mc, n, MC_STOPONERR);
+	if (r<0) {
+		err(1, "multicall");
+	}
+	if (r>0 && mc[r-1].mc_err) {
+		errno = mc[r-1].mc_err;
+		err(1, "%s: remove", (const char *)mc[r-1].mc_args[0]);
+	}
 
 	/* Leave the dir */
 	if (chdir("..")<0) {
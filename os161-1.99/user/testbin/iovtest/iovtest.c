@@ -0,0 +1,139 @@
+/*
+ * iovtest - exercise readv, writev, preadv and pwritev.
+ *
+ * Usage: iovtest [file]
+ *
+ * Writes a run of fixed-size records, each as a header and a payload
+ * in a single writev, then reads them back with readv and checks
+ * them. Finally rewrites one record in place with pwritev, reads it
+ * back with preadv, and checks that neither call moved the offset.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define NRECS 32
+#define PAYLOAD 100
+
+struct rechdr {
+	int rh_seq;
+	int rh_len;
+};
+
+static char payload[PAYLOAD];
+static char check[PAYLOAD];
+
+static
+void
+fill(char *buf, int seq)
+{
+	int i;
+
+	for (i=0; i<PAYLOAD; i++) {
+		buf[i] = 'a' + (seq + i) % 26;
+	}
+}
+
+static
+void
+setiov(struct iovec *iov, struct rechdr *h, char *buf)
+{
+	iov[0].iov_base = h;
+	iov[0].iov_len = sizeof(*h);
+	iov[1].iov_base = buf;
+	iov[1].iov_len = PAYLOAD;
+}
+
+static
+void
+checkrec(struct rechdr *h, int seq)
+{
+	char expect[PAYLOAD];
+
+	if (h->rh_seq != seq || h->rh_len != PAYLOAD) {
+		errx(1, "record %d: bad header (%d, %d)", seq,
+		     h->rh_seq, h->rh_len);
+	}
+	fill(expect, seq);
+	if (memcmp(check, expect, PAYLOAD)) {
+		errx(1, "record %d: bad payload", seq);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file = "iovtest.dat";
+	struct iovec iov[2];
+	struct rechdr h;
+	const int reclen = sizeof(h) + PAYLOAD;
+	int fd, i, r;
+
+	if (argc > 1) {
+		file = argv[1];
+	}
+
+	fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+
+	for (i=0; i<NRECS; i++) {
+		h.rh_seq = i;
+		h.rh_len = PAYLOAD;
+		fill(payload, i);
+		setiov(iov, &h, payload);
+		r = writev(fd, iov, 2);
+		if (r < 0) {
+			err(1, "writev");
+		}
+		if (r != reclen) {
+			errx(1, "writev: short count %d", r);
+		}
+	}
+
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+		err(1, "lseek");
+	}
+	for (i=0; i<NRECS; i++) {
+		setiov(iov, &h, check);
+		r = readv(fd, iov, 2);
+		if (r < 0) {
+			err(1, "readv");
+		}
+		if (r != reclen) {
+			errx(1, "readv: short count %d", r);
+		}
+		checkrec(&h, i);
+	}
+
+	/* rewrite record 3 as record 7 without touching the offset */
+	h.rh_seq = 7;
+	h.rh_len = PAYLOAD;
+	fill(payload, 7);
+	setiov(iov, &h, payload);
+	r = pwritev(fd, iov, 2, 3 * reclen);
+	if (r != reclen) {
+		err(1, "pwritev");
+	}
+	setiov(iov, &h, check);
+	r = preadv(fd, iov, 2, 3 * reclen);
+	if (r != reclen) {
+		err(1, "preadv");
+	}
+	checkrec(&h, 7);
+	if (lseek(fd, 0, SEEK_CUR) != NRECS * reclen) {
+		errx(1, "pwritev/preadv moved the file offset");
+	}
+
+	if (readv(fd, iov, 0) >= 0) {
+		errx(1, "readv with no iovecs succeeded");
+	}
+
+	close(fd);
+	remove(file);
+	printf("iovtest: passed\n");
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * kstatread - read kstat: to EOF in small pieces.
+ *
+ * Usage: kstatread [bufsize]
+ *
+ * kstat: can't seek, but it still has to report EOF once a reader has
+ * had the whole snapshot, or cat kstat: and every other read loop
+ * would run forever. Reads with a small buffer (default 16 bytes) and
+ * fails if EOF hasn't come by the time far more than one snapshot's
+ * worth has been read, or if what comes back isn't text ending in a
+ * newline (as it wouldn't be if a read ran off the end of the
+ * kernel's snapshot buffer).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_BUFSIZE 16
+#define MAXTOTAL (256*1024)
+
+static char buf[4096];
+
+int
+main(int argc, char *argv[])
+{
+	int fd, r, bufsize = DEFAULT_BUFSIZE;
+	int total, reads, i;
+	char last = 0;
+
+	if (argc > 1) {
+		bufsize = atoi(argv[1]);
+		if (bufsize < 1 || bufsize > (int)sizeof(buf)) {
+			errx(1, "Usage: kstatread [bufsize]");
+		}
+	}
+
+	fd = open("kstat:", O_RDONLY);
+	if (fd < 0) {
+		err(1, "kstat:");
+	}
+
+	total = reads = 0;
+	while ((r = read(fd, buf, bufsize)) > 0) {
+		for (i=0; i<r; i++) {
+			if (buf[i] == 0) {
+				errx(1, "kstat: returned a NUL byte");
+			}
+		}
+		last = buf[r-1];
+		total += r;
+		reads++;
+		if (total > MAXTOTAL) {
+			errx(1, "no EOF after %d bytes", total);
+		}
+	}
+	if (r < 0) {
+		err(1, "kstat: read");
+	}
+	if (total == 0) {
+		errx(1, "kstat: was empty");
+	}
+	if (last != '\n') {
+		errx(1, "kstat: didn't end with a newline");
+	}
+
+	close(fd);
+	printf("kstatread: %d bytes in %d reads, passed\n", total, reads);
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * manyargs - exec argtest with a very long argument list.
+ *
+ * Usage: manyargs [count]
+ *
+ * Builds count arguments (2000 by default) and execs /testbin/argtest
+ * with them, to exercise argument passing near the limit. The kernel
+ * takes at most ARG_MAX bytes of arguments and pointers, and less if
+ * they would not fit on the new stack (44K under dumbvm); past that,
+ * execv should fail cleanly with E2BIG.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_COUNT 2000
+#define MAX_COUNT 20000
+#define ARGLEN 8
+
+static char *args[MAX_COUNT + 2];
+static char strings[MAX_COUNT][ARGLEN];
+
+int
+main(int argc, char *argv[])
+{
+	int count = DEFAULT_COUNT;
+	int i;
+
+	if (argc > 1) {
+		count = atoi(argv[1]);
+	}
+	if (count < 0 || count > MAX_COUNT) {
+		errx(1, "Usage: manyargs [0-%d]", MAX_COUNT);
+	}
+
+	args[0] = (char *)"/testbin/argtest";
+	for (i=0; i<count; i++) {
+		snprintf(strings[i], ARGLEN, "a%d", i);
+		args[i+1] = strings[i];
+	}
+	args[count+1] = NULL;
+
+	execv(args[0], args);
+	err(1, "%s", args[0]);
+}
@@ -0,0 +1,124 @@
+/*
+ * multicalltest - check how multicall passes arguments and results.
+ *
+ * Usage: multicalltest [file]
+ *
+ * Runs a batch of lseeks and a pwrite on a file in one multicall. The
+ * lseeks take whence from the stack (sp+16) and return offsets past
+ * 4G, and the pwrite takes its whole position from the stack, so both
+ * stack arguments and the high word of a 64-bit result have to make
+ * it through. Also seeks a directory, checks that a bad
+ * call gets its own error without disturbing the rest, and that
+ * MC_STOPONERR stops after it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <kern/seek.h>
+#include <kern/syscall.h>
+
+#define BIGPOS (((off_t)1 << 32) + 16)
+
+static const char data[] = "multicall";
+
+static
+void
+setlseek(struct multicall *mc, int fd, off_t pos, int whence)
+{
+	memset(mc, 0, sizeof(*mc));
+	mc->mc_callno = SYS_lseek;
+	mc->mc_args[0] = fd;
+	/* the offset takes the aligned a2/a3 pair; whence is at sp+16 */
+	mc->mc_args[2] = (unsigned long)((unsigned long long)pos >> 32);
+	mc->mc_args[3] = (unsigned long)pos;
+	mc->mc_args[4] = whence;
+}
+
+static
+void
+check(struct multicall *mc, int i, int err, off_t retval)
+{
+	if (mc[i].mc_err != err) {
+		errx(1, "call %d: error %d, expected %d", i,
+		     mc[i].mc_err, err);
+	}
+	if (err == 0 && mc[i].mc_retval != retval) {
+		errx(1, "call %d: returned 0x%llx, expected 0x%llx", i,
+		     (unsigned long long)mc[i].mc_retval,
+		     (unsigned long long)retval);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file = "multicalltest.dat";
+	struct multicall mc[6];
+	char buf[sizeof(data)];
+	int fd, dirfd, r;
+
+	if (argc > 1) {
+		file = argv[1];
+	}
+
+	fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	dirfd = open(".", O_RDONLY);
+	if (dirfd < 0) {
+		err(1, ".");
+	}
+
+	setlseek(&mc[0], fd, BIGPOS, SEEK_SET);
+	setlseek(&mc[1], fd, -16, SEEK_CUR);
+	setlseek(&mc[2], -1, 0, SEEK_SET);
+
+	/* pwrite(fd, data, len, 4): a3 is padding, the position is stacked */
+	memset(&mc[3], 0, sizeof(mc[3]));
+	mc[3].mc_callno = SYS_pwrite;
+	mc[3].mc_args[0] = fd;
+	mc[3].mc_args[1] = (unsigned long)data;
+	mc[3].mc_args[2] = sizeof(data);
+	mc[3].mc_args[4] = 0;
+	mc[3].mc_args[5] = 4;
+
+	setlseek(&mc[4], fd, 0, SEEK_END);
+	setlseek(&mc[5], dirfd, 0, SEEK_CUR);
+
+	r = multicall(mc, 6, 0);
+	if (r != 6) {
+		errx(1, "multicall ran %d calls, expected 6", r);
+	}
+	check(mc, 0, 0, BIGPOS);
+	check(mc, 1, 0, (off_t)1 << 32);
+	check(mc, 2, EBADF, 0);
+	check(mc, 3, 0, sizeof(data));
+	check(mc, 4, 0, 4 + sizeof(data));
+	check(mc, 5, 0, 0);
+
+	/* the seeks really happened, and the write went where it said */
+	if (lseek(fd, 0, SEEK_CUR) != 4 + (off_t)sizeof(data)) {
+		errx(1, "file offset is wrong after the batch");
+	}
+	if (pread(fd, buf, sizeof(buf), 4) != sizeof(buf) ||
+	    memcmp(buf, data, sizeof(data)) != 0) {
+		errx(1, "pwrite in the batch wrote the wrong thing");
+	}
+
+	/* with MC_STOPONERR the bad call is the last one run */
+	r = multicall(mc, 6, MC_STOPONERR);
+	if (r != 3) {
+		errx(1, "MC_STOPONERR: ran %d calls, expected 3", r);
+	}
+	check(mc, 2, EBADF, 0);
+
+	close(dirfd);
+	close(fd);
+	remove(file);
+	printf("multicalltest: passed\n");
+	return 0;
+}
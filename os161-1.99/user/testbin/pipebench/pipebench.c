@@ -0,0 +1,117 @@
+/*
+ * pipebench - measure pipe throughput between two processes.
+ *
+ * Usage: pipebench [megabytes [chunksize]]
+ *
+ * Forks a child that reads from a pipe until end of file, while the
+ * parent writes the given amount (4MB by default) into it in chunks
+ * of the given size (4096 bytes by default). The child checks that it
+ * got every byte, in order, and the parent prints the rate.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_MB 4
+#define DEFAULT_CHUNK 4096
+#define MAX_CHUNK 65536
+
+static char buf[MAX_CHUNK];
+
+static
+void
+reader(int fd, unsigned long long total)
+{
+	unsigned long long got = 0;
+	int r, i;
+
+	while ((r = read(fd, buf, sizeof(buf))) > 0) {
+		for (i=0; i<r; i++) {
+			if (buf[i] != (char)((got + i) % 251)) {
+				errx(1, "byte %llu is wrong", got + i);
+			}
+		}
+		got += r;
+	}
+	if (r < 0) {
+		err(1, "read");
+	}
+	if (got != total) {
+		errx(1, "got %llu bytes, expected %llu", got, total);
+	}
+	_exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int mb = DEFAULT_MB, chunk = DEFAULT_CHUNK;
+	unsigned long long total, sent, usec, rate;
+	int fds[2], status, r, i, len;
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	pid_t pid;
+
+	if (argc > 1) {
+		mb = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		chunk = atoi(argv[2]);
+	}
+	if (mb < 1 || chunk < 1 || chunk > MAX_CHUNK) {
+		errx(1, "Usage: pipebench [megabytes [chunksize]]");
+	}
+	total = (unsigned long long)mb * 1024 * 1024;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		close(fds[1]);
+		reader(fds[0], total);
+	}
+	close(fds[0]);
+
+	__time(&s0, &ns0);
+	for (sent = 0; sent < total; sent += r) {
+		len = chunk;
+		if (total - sent < (unsigned long long)len) {
+			len = total - sent;
+		}
+		for (i=0; i<len; i++) {
+			buf[i] = (sent + i) % 251;
+		}
+		r = write(fds[1], buf, len);
+		if (r <= 0) {
+			err(1, "write");
+		}
+	}
+	close(fds[1]);
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	__time(&s1, &ns1);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "reader failed");
+	}
+
+	usec = (unsigned long long)(s1 - s0) * 1000000;
+	usec = usec + ns1 / 1000 - ns0 / 1000;
+	if (usec == 0) {
+		usec = 1;
+	}
+	/* bytes per microsecond is MB/s; report it in hundredths */
+	rate = (total * 100) / usec;
+	printf("pipebench: %d MB in %d byte writes: %llu us, %llu.%02llu MB/s\n",
+	       mb, chunk, usec, rate / 100, rate % 100);
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * polltest - serve several pipes from one process with poll().
+ *
+ * Usage: polltest
+ *
+ * Starts NWRITERS children, each writing a few numbered messages into
+ * its own pipe with pauses in between, and reads them all from the
+ * parent in a single poll() loop, checking that every message arrives
+ * once, in order per pipe, and that each pipe reports hangup when its
+ * writer is done. Also checks that a timeout on an idle pipe expires
+ * and that a bad descriptor comes back as POLLNVAL.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <err.h>
+
+#define NWRITERS 4
+#define NMSGS 8
+
+static
+void
+spin(int n)
+{
+	volatile int i;
+
+	for (i=0; i<n * 100000; i++) {
+		/* spin */
+	}
+}
+
+static
+void
+writer(int fd, int me)
+{
+	int i, msg;
+
+	for (i=0; i<NMSGS; i++) {
+		spin(me + 1);
+		msg = me * 1000 + i;
+		if (write(fd, &msg, sizeof(msg)) != sizeof(msg)) {
+			err(1, "writer %d: write", me);
+		}
+	}
+	_exit(0);
+}
+
+static
+void
+check_timeout(void)
+{
+	struct pollfd pfd;
+	int fds[2], r;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	r = poll(&pfd, 1, 100);
+	if (r < 0) {
+		err(1, "poll with timeout");
+	}
+	if (r != 0 || pfd.revents != 0) {
+		errx(1, "idle pipe polled ready");
+	}
+
+	pfd.fd = fds[1];
+	pfd.events = POLLOUT;
+	if (poll(&pfd, 1, 0) != 1 || pfd.revents != POLLOUT) {
+		errx(1, "empty pipe not writable");
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) != 1 || pfd.revents != POLLNVAL) {
+		errx(1, "closed descriptor not POLLNVAL");
+	}
+}
+
+int
+main(void)
+{
+	struct pollfd pfds[NWRITERS];
+	int next[NWRITERS];
+	pid_t pids[NWRITERS];
+	int fds[2], i, r, msg, nopen, status;
+
+	check_timeout();
+
+	for (i=0; i<NWRITERS; i++) {
+		if (pipe(fds) < 0) {
+			err(1, "pipe");
+		}
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			close(fds[0]);
+			writer(fds[1], i);
+		}
+		close(fds[1]);
+		pfds[i].fd = fds[0];
+		pfds[i].events = POLLIN;
+		next[i] = 0;
+	}
+
+	nopen = NWRITERS;
+	while (nopen > 0) {
+		r = poll(pfds, NWRITERS, -1);
+		if (r < 0) {
+			err(1, "poll");
+		}
+		if (r == 0) {
+			errx(1, "poll returned nothing without a timeout");
+		}
+		for (i=0; i<NWRITERS; i++) {
+			if (pfds[i].revents & POLLIN) {
+				r = read(pfds[i].fd, &msg, sizeof(msg));
+				if (r != sizeof(msg)) {
+					errx(1, "pipe %d: short read %d", i, r);
+				}
+				if (msg != i * 1000 + next[i]) {
+					errx(1, "pipe %d: got %d", i, msg);
+				}
+				next[i]++;
+			}
+			else if (pfds[i].revents & POLLHUP) {
+				if (next[i] != NMSGS) {
+					errx(1, "pipe %d: hangup after %d",
+					     i, next[i]);
+				}
+				close(pfds[i].fd);
+				pfds[i].fd = -1;
+				nopen--;
+			}
+			else if (pfds[i].revents != 0) {
+				errx(1, "pipe %d: revents %d", i,
+				     pfds[i].revents);
+			}
+		}
+	}
+
+	for (i=0; i<NWRITERS; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+	}
+	printf("polltest: passed\n");
+	return 0;
+}
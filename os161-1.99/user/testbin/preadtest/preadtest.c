@@ -0,0 +1,124 @@
+/*
+ * preadtest - parallel positional reads of one shared open file.
+ *
+ * Usage: preadtest [file]
+ *
+ * Writes a file of numbered blocks with pwrite, then forks several
+ * workers that all inherit the same open file and check disjoint
+ * ranges of it with pread. Since pread never uses the shared seek
+ * pointer, the workers need no coordination, and the parent's offset
+ * should be unchanged when they are done.
+ */
+
+#include <sys/wait.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <err.h>
+
+#define NWORKERS 4
+#define BLOCKSPER 16
+#define BLOCKINTS 128
+#define BLOCKSIZE (BLOCKINTS * sizeof(int))
+
+static int buf[BLOCKINTS];
+
+static
+void
+fill(int block)
+{
+	int i;
+
+	for (i=0; i<BLOCKINTS; i++) {
+		buf[i] = block * BLOCKINTS + i;
+	}
+}
+
+static
+void
+worker(int fd, int me)
+{
+	int b, i, r;
+	off_t pos;
+
+	for (b = me * BLOCKSPER; b < (me + 1) * BLOCKSPER; b++) {
+		pos = (off_t)b * BLOCKSIZE;
+		r = pread(fd, buf, BLOCKSIZE, pos);
+		if (r < 0) {
+			err(1, "worker %d: pread", me);
+		}
+		if (r != BLOCKSIZE) {
+			errx(1, "worker %d: short pread %d", me, r);
+		}
+		for (i=0; i<BLOCKINTS; i++) {
+			if (buf[i] != b * BLOCKINTS + i) {
+				errx(1, "worker %d: block %d is wrong", me, b);
+			}
+		}
+	}
+	_exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file = "preadtest.dat";
+	pid_t pids[NWORKERS];
+	int fd, b, i, r, status, failed;
+
+	if (argc > 1) {
+		file = argv[1];
+	}
+
+	fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+
+	/* write the blocks back to front; the offset should not move */
+	for (b = NWORKERS * BLOCKSPER - 1; b >= 0; b--) {
+		fill(b);
+		r = pwrite(fd, buf, BLOCKSIZE, (off_t)b * BLOCKSIZE);
+		if (r != BLOCKSIZE) {
+			err(1, "pwrite");
+		}
+	}
+	if (lseek(fd, 0, SEEK_CUR) != 0) {
+		errx(1, "pwrite moved the file offset");
+	}
+
+	for (i=0; i<NWORKERS; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			worker(fd, i);
+		}
+	}
+
+	failed = 0;
+	for (i=0; i<NWORKERS; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			warnx("worker %d failed", i);
+			failed = 1;
+		}
+	}
+
+	if (lseek(fd, 0, SEEK_CUR) != 0) {
+		errx(1, "pread moved the file offset");
+	}
+	if (pread(fd, buf, BLOCKSIZE, -1) >= 0) {
+		errx(1, "pread at a negative offset succeeded");
+	}
+
+	close(fd);
+	remove(file);
+	if (failed) {
+		return 1;
+	}
+	printf("preadtest: passed\n");
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * spawnbench - compare fork+exec, vfork+exec and spawn.
+ *
+ * Usage: spawnbench [count [program [args...]]]
+ *
+ * Runs the program (by default /bin/true, the kind of small command
+ * the shell spends its life starting) count times with each method,
+ * waiting for it each time, and prints the average time per spawn.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_COUNT 50
+
+static char *default_args[] = { (char *)"/bin/true", NULL };
+
+/* ways to start the program */
+#define M_FORK  0	/* fork, then exec in the child */
+#define M_VFORK 1	/* vfork, then exec in the child */
+#define M_SPAWN 2	/* the spawn() system call */
+
+static
+void
+run_once(int method, char **args)
+{
+	pid_t pid;
+	int status;
+
+	if (method == M_SPAWN) {
+		pid = spawn(args[0], args);
+		if (pid < 0) {
+			err(1, "spawn: %s", args[0]);
+		}
+	}
+	else {
+		pid = (method == M_VFORK) ? vfork() : fork();
+		if (pid < 0) {
+			err(1, method == M_VFORK ? "vfork" : "fork");
+		}
+		if (pid == 0) {
+			execv(args[0], args);
+			/* only _exit is safe in a vfork child */
+			_exit(255);
+		}
+	}
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) == 255) {
+		errx(1, "%s: exec failed or bad status %d", args[0], status);
+	}
+}
+
+static
+void
+bench(const char *name, int method, int count, char **args)
+{
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	unsigned long long usec;
+	int i;
+
+	__time(&s0, &ns0);
+	for (i=0; i<count; i++) {
+		run_once(method, args);
+	}
+	__time(&s1, &ns1);
+
+	usec = (unsigned long long)(s1 - s0) * 1000000;
+	usec = usec + ns1 / 1000 - ns0 / 1000;
+	printf("%s: %d spawns in %llu us, %llu us each\n",
+	       name, count, usec, usec / count);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int count = DEFAULT_COUNT;
+	char **args = default_args;
+
+	if (argc > 1) {
+		count = atoi(argv[1]);
+		if (count < 1) {
+			errx(1, "Usage: spawnbench [count [program [args...]]]");
+		}
+	}
+	if (argc > 2) {
+		args = &argv[2];
+	}
+
+	bench("fork+exec", M_FORK, count, args);
+	bench("vfork+exec", M_VFORK, count, args);
+	bench("spawn", M_SPAWN, count, args);
+	return 0;
+}
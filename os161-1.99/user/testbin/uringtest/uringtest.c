@@ -0,0 +1,163 @@
+/*
+ * uringtest - asynchronous I/O through a submission/completion ring.
+ *
+ * Usage: uringtest [file]
+ *
+ * Queues a write of every block of a file at its own offset, submits
+ * them all with one uring_enter, and waits for the completions; then
+ * does the same with reads into separate buffers and checks the data.
+ * A NOP, a bad descriptor and a bad buffer ride along in each batch
+ * to check that they complete with the right result and don't hold up
+ * the rest.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+
+#define NBLOCKS 32
+#define BLOCKINTS 128
+#define BLOCKSIZE (BLOCKINTS * sizeof(int))
+
+/* userdata tags for the extra requests; blocks use their number */
+#define TAG_NOP    (NBLOCKS)
+#define TAG_BADFD  (NBLOCKS + 1)
+#define TAG_BADBUF (NBLOCKS + 2)
+#define NTAGS      (NBLOCKS + 3)
+
+static struct uring_ring *ring;
+static int blocks[NBLOCKS][BLOCKINTS];
+static int results[NTAGS];
+
+static
+void
+push(int op, int fd, void *buf, size_t len, off_t pos, unsigned long tag)
+{
+	struct uring_sqe *sqe;
+
+	if (ring->ur_sqtail - ring->ur_sqhead == URING_SQ_ENTRIES) {
+		errx(1, "submission ring full");
+	}
+	sqe = &ring->ur_sq[ring->ur_sqtail % URING_SQ_ENTRIES];
+	sqe->sqe_op = op;
+	sqe->sqe_fd = fd;
+	sqe->sqe_buf = buf;
+	sqe->sqe_len = len;
+	sqe->sqe_offset = pos;
+	sqe->sqe_userdata = tag;
+	ring->ur_sqtail++;
+}
+
+/*
+ * Queue one request per block plus the extras, submit, and collect
+ * every completion into results[].
+ */
+static
+void
+batch(int op, int fd)
+{
+	struct uring_cqe *cqe;
+	unsigned done, enters;
+	int b, r;
+
+	for (b=0; b<NBLOCKS; b++) {
+		push(op, fd, blocks[b], BLOCKSIZE, (off_t)b * BLOCKSIZE, b);
+	}
+	push(URING_OP_NOP, -1, NULL, 0, 0, TAG_NOP);
+	push(op, -1, blocks[0], BLOCKSIZE, 0, TAG_BADFD);
+	push(op, fd, (void *)0x40, BLOCKSIZE, 0, TAG_BADBUF);
+
+	for (b=0; b<NTAGS; b++) {
+		results[b] = 1;
+	}
+
+	done = enters = 0;
+	while (done < NTAGS) {
+		r = uring_enter(ring->ur_sqtail - ring->ur_sqhead, NTAGS - done);
+		if (r < 0) {
+			err(1, "uring_enter");
+		}
+		enters++;
+		while (ring->ur_cqhead != ring->ur_cqtail) {
+			cqe = &ring->ur_cq[ring->ur_cqhead % URING_CQ_ENTRIES];
+			if (cqe->cqe_userdata >= NTAGS ||
+			    results[cqe->cqe_userdata] != 1) {
+				errx(1, "bogus completion %lu",
+				     cqe->cqe_userdata);
+			}
+			results[cqe->cqe_userdata] = cqe->cqe_result;
+			ring->ur_cqhead++;
+			done++;
+		}
+	}
+
+	for (b=0; b<NBLOCKS; b++) {
+		if (results[b] != (int)BLOCKSIZE) {
+			errx(1, "block %d: result %d", b, results[b]);
+		}
+	}
+	if (results[TAG_NOP] != 0) {
+		errx(1, "nop: result %d", results[TAG_NOP]);
+	}
+	if (results[TAG_BADFD] != -EBADF) {
+		errx(1, "bad fd: result %d", results[TAG_BADFD]);
+	}
+	if (results[TAG_BADBUF] != -EFAULT) {
+		errx(1, "bad buffer: result %d", results[TAG_BADBUF]);
+	}
+	printf("uringtest: %d requests, %u uring_enter calls\n",
+	       NTAGS, enters);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *file = "uringtest.dat";
+	struct uring_ring *again;
+	int fd, b, i;
+
+	if (argc > 1) {
+		file = argv[1];
+	}
+
+	if (uring_setup(&ring) < 0) {
+		err(1, "uring_setup");
+	}
+	if (uring_setup(&again) == 0) {
+		errx(1, "second uring_setup succeeded");
+	}
+
+	fd = open(file, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+
+	for (b=0; b<NBLOCKS; b++) {
+		for (i=0; i<BLOCKINTS; i++) {
+			blocks[b][i] = b * BLOCKINTS + i;
+		}
+	}
+	batch(URING_OP_WRITE, fd);
+
+	memset(blocks, 0, sizeof(blocks));
+	batch(URING_OP_READ, fd);
+	for (b=0; b<NBLOCKS; b++) {
+		for (i=0; i<BLOCKINTS; i++) {
+			if (blocks[b][i] != b * BLOCKINTS + i) {
+				errx(1, "block %d is wrong", b);
+			}
+		}
+	}
+
+	/* every request had its own offset */
+	if (lseek(fd, 0, SEEK_CUR) != 0) {
+		errx(1, "the file offset moved");
+	}
+
+	close(fd);
+	remove(file);
+	printf("uringtest: passed\n");
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * widefork - one parent with many children.
+ *
+ * Forks a wide, flat family (200 children by default, or argv[1]),
+ * then waits for half of them in reverse order and checks each exit
+ * status, and reaps some more with waitpid(-1), blocking and WNOHANG.
+ * The parent then exits with some children still unwaited-for, which
+ * exercises reaping a long child list in one go. Run it several
+ * times in a row to check that pids get recycled.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_CHILDREN 200
+#define MAX_CHILDREN 1000
+
+static pid_t pids[MAX_CHILDREN];
+
+int
+main(int argc, char *argv[])
+{
+	int n, i, status;
+	pid_t pid;
+
+	n = DEFAULT_CHILDREN;
+	if (argc > 1) {
+		n = atoi(argv[1]);
+	}
+	if (n < 1 || n > MAX_CHILDREN) {
+		errx(1, "Usage: widefork [1-%d]", MAX_CHILDREN);
+	}
+
+	for (i=0; i<n; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork %d", i);
+		}
+		if (pid == 0) {
+			_exit(i % 256);
+		}
+		pids[i] = pid;
+	}
+
+	/* wait for the second half only; the rest are reaped at exit */
+	for (i=n-1; i>=n/2; i--) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid %d", pids[i]);
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != i % 256) {
+			errx(1, "child %d (pid %d): bad status %d",
+			     i, pids[i], status);
+		}
+	}
+
+	/* reap half of what is left through wait-for-any */
+	for (i=0; i<n/4; i++) {
+		pid = waitpid(-1, &status, i % 2 ? WNOHANG : 0);
+		if (pid < 0) {
+			err(1, "waitpid -1");
+		}
+		if (pid > 0 && !WIFEXITED(status)) {
+			errx(1, "pid %d: bad status %d", pid, status);
+		}
+	}
+
+	printf("widefork: %d children ok\n", n);
+	return 0;
+}